@@ -0,0 +1,42 @@
+/*
+ * Copyright (c) 2020 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+/* Mouse press behavior */
+/* Left click */
+#define MB1 (0x01)
+#define LCLK (MB1)
+
+/* Right click */
+#define MB2 (0x02)
+#define RCLK (MB2)
+
+/* Middle click */
+#define MB3 (0x04)
+#define MCLK (MB3)
+
+#define MB4 (0x08)
+#define MB5 (0x10)
+
+/* Mouse move and scroll behaviors */
+/* Speeds are the maximum speed in pixels (or scroll steps) per second */
+#define MOVE_Y(vert) ((vert)&0xFFFF)
+#define MOVE_Y_DECODE(encoded) (int16_t)((encoded)&0x0000FFFF)
+#define MOVE_X(hor) (((hor)&0xFFFF) << 16)
+#define MOVE_X_DECODE(encoded) (int16_t)(((encoded)&0xFFFF0000) >> 16)
+
+#define MOVE(hor, vert) (MOVE_X(hor) + MOVE_Y(vert))
+
+#define MOVE_UP MOVE_Y(-600)
+#define MOVE_DOWN MOVE_Y(600)
+#define MOVE_LEFT MOVE_X(-600)
+#define MOVE_RIGHT MOVE_X(600)
+
+#define SCRL_UP MOVE_Y(10)
+#define SCRL_DOWN MOVE_Y(-10)
+#define SCRL_LEFT MOVE_X(-10)
+#define SCRL_RIGHT MOVE_X(10)
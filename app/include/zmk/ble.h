@@ -6,6 +6,8 @@
 
 #pragma once
 
+#include <bluetooth/conn.h>
+
 #include <zmk/keys.h>
 #include <zmk/ble/profile.h>
 
@@ -18,6 +20,13 @@ int zmk_ble_active_profile_index();
 bt_addr_le_t *zmk_ble_active_profile_addr();
 bool zmk_ble_active_profile_is_open();
 bool zmk_ble_active_profile_is_connected();
+// The connection to the active profile's peer, or NULL. The returned pointer is not referenced
+// for the caller, and is only valid until the active profile changes or disconnects.
+struct bt_conn *zmk_ble_active_profile_conn();
+// The connection to the given profile's peer, or NULL. Not referenced for the caller, see above.
+struct bt_conn *zmk_ble_profile_conn(uint8_t index);
+int zmk_ble_profile_count();
+int zmk_ble_connected_profile_count();
 char *zmk_ble_active_profile_name();
 
 int zmk_ble_unpair_all();
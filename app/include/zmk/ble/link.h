@@ -0,0 +1,29 @@
+/*
+ * Copyright (c) 2020 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <bluetooth/conn.h>
+
+// State of a host connection's link, as negotiated with the host.
+struct zmk_ble_link_stats {
+    // Connection interval in 1.25ms units, slave latency in connection events and supervision
+    // timeout in 10ms units.
+    uint16_t interval;
+    uint16_t latency;
+    uint16_t timeout;
+    // BT_GAP_LE_PHY_* of each direction.
+    uint8_t tx_phy;
+    uint8_t rx_phy;
+    // Maximum link layer payload in octets of each direction.
+    uint16_t tx_max_len;
+    uint16_t rx_max_len;
+    // Number of times the host changed the parameters or PHY after the connection was made.
+    uint16_t param_updates;
+    uint16_t phy_updates;
+};
+
+int zmk_ble_link_get_stats(struct bt_conn *conn, struct zmk_ble_link_stats *stats);
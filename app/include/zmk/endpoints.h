@@ -18,4 +18,12 @@ int zmk_endpoints_select(enum zmk_endpoint endpoint);
 int zmk_endpoints_toggle();
 enum zmk_endpoint zmk_endpoints_selected();
 
+// While broadcasting, reports go to USB and all connected BLE profiles at the same time.
+int zmk_endpoints_set_broadcast(bool enable);
+bool zmk_endpoints_is_broadcast();
+
 int zmk_endpoints_send_report(uint8_t usage_report);
+
+#if IS_ENABLED(CONFIG_ZMK_MOUSE)
+int zmk_endpoints_send_mouse_report();
+#endif /* IS_ENABLED(CONFIG_ZMK_MOUSE) */
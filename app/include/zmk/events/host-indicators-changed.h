@@ -0,0 +1,19 @@
+/*
+ * Copyright (c) 2020 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <zephyr.h>
+
+#include <zmk/event-manager.h>
+#include <zmk/hid.h>
+
+struct host_indicators_changed {
+    struct zmk_event_header header;
+    zmk_hid_indicators indicators;
+};
+
+ZMK_EVENT_DECLARE(host_indicators_changed);
@@ -0,0 +1,30 @@
+/*
+ * Copyright (c) 2020 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <zephyr.h>
+#include <zmk/event-manager.h>
+#include <zmk/mouse.h>
+
+struct mouse_button_state_changed {
+    struct zmk_event_header header;
+    zmk_mouse_button_flags buttons;
+    bool state;
+    int64_t timestamp;
+};
+
+ZMK_EVENT_DECLARE(mouse_button_state_changed);
+
+static inline struct mouse_button_state_changed *
+create_mouse_button_state_changed(zmk_mouse_button_flags buttons, bool state, int64_t timestamp) {
+    struct mouse_button_state_changed *ev = new_mouse_button_state_changed();
+    ev->buttons = buttons;
+    ev->state = state;
+    ev->timestamp = timestamp;
+
+    return ev;
+}
@@ -0,0 +1,38 @@
+/*
+ * Copyright (c) 2020 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <zephyr.h>
+#include <zmk/event-manager.h>
+#include <zmk/mouse.h>
+
+struct mouse_move_state_changed {
+    struct zmk_event_header header;
+    // Pointer movement when false, wheel/pan scrolling when true.
+    bool scroll;
+    struct vector2d max_speed;
+    struct zmk_mouse_move_config config;
+    bool state;
+    int64_t timestamp;
+};
+
+ZMK_EVENT_DECLARE(mouse_move_state_changed);
+
+static inline struct mouse_move_state_changed *
+create_mouse_move_state_changed(bool scroll, uint32_t encoded_speed,
+                                struct zmk_mouse_move_config config, bool state,
+                                int64_t timestamp) {
+    struct mouse_move_state_changed *ev = new_mouse_move_state_changed();
+    ev->scroll = scroll;
+    ev->max_speed.x = MOVE_X_DECODE(encoded_speed);
+    ev->max_speed.y = MOVE_Y_DECODE(encoded_speed);
+    ev->config = config;
+    ev->state = state;
+    ev->timestamp = timestamp;
+
+    return ev;
+}
@@ -10,146 +10,514 @@
 #include <usb/class/usb_hid.h>
 
 #include <zmk/keys.h>
+#include <zmk/mouse.h>
 #include <dt-bindings/zmk/hid_usage.h>
 #include <dt-bindings/zmk/hid_usage_pages.h>
 
 #define COLLECTION_REPORT 0x03
 
+enum zmk_hid_report_id {
+    ZMK_HID_REPORT_ID_KEYBOARD = 0x01,
+    ZMK_HID_REPORT_ID_CONSUMER = 0x02,
+    ZMK_HID_REPORT_ID_MOUSE = 0x03,
+    ZMK_HID_REPORT_ID_RAW = 0x04,
+};
+
 #define ZMK_HID_KEYBOARD_NKRO_SIZE 6
 
-#define ZMK_HID_CONSUMER_NKRO_SIZE 6
+#if IS_ENABLED(CONFIG_ZMK_HID_KEYBOARD_NKRO_EXTENDED_REPORT)
+// Every usage below the modifiers, which have their own byte.
+#define ZMK_HID_KEYBOARD_NKRO_MAX_USAGE (HID_USAGE_KEY_KEYBOARD_LEFTCONTROL - 1)
+#define ZMK_HID_KEYBOARD_NKRO_OVERFLOW_SIZE 0
+#else
+#define ZMK_HID_KEYBOARD_NKRO_MAX_USAGE HID_USAGE_KEY_KEYPAD_EQUAL
+// Usages above the bitmap, like F13-F24 and the international and language keys, are reported in
+// a small 6KRO style array. With it, the report body still fits a notification at the default BLE
+// ATT MTU of 23 bytes.
+#define ZMK_HID_KEYBOARD_NKRO_OVERFLOW_SIZE 4
+#endif
 
-static const uint8_t zmk_hid_report_desc[] = {
-    /* USAGE_PAGE (Generic Desktop) */
-    HID_GI_USAGE_PAGE,
-    HID_USAGE_GD,
-    /* USAGE (Keyboard) */
-    HID_LI_USAGE,
-    HID_USAGE_GD_KEYBOARD,
-    /* COLLECTION (Application) */
-    HID_MI_COLLECTION,
-    COLLECTION_APPLICATION,
-    /* REPORT ID (1) */
-    HID_GI_REPORT_ID,
-    0x01,
-    /* USAGE_PAGE (Keyboard/Keypad) */
-    HID_GI_USAGE_PAGE,
-    HID_USAGE_KEY,
-    /* USAGE_MINIMUM (Keyboard LeftControl) */
-    HID_LI_USAGE_MIN(1),
-    HID_USAGE_KEY_KEYBOARD_LEFTCONTROL,
-    /* USAGE_MAXIMUM (Keyboard Right GUI) */
-    HID_LI_USAGE_MAX(1),
-    HID_USAGE_KEY_KEYBOARD_RIGHT_GUI,
-    /* LOGICAL_MINIMUM (0) */
-    HID_GI_LOGICAL_MIN(1),
-    0x00,
-    /* LOGICAL_MAXIMUM (1) */
-    HID_GI_LOGICAL_MAX(1),
-    0x01,
-
-    /* REPORT_SIZE (1) */
-    HID_GI_REPORT_SIZE,
-    0x01,
-    /* REPORT_COUNT (8) */
-    HID_GI_REPORT_COUNT,
-    0x08,
-    /* INPUT (Data,Var,Abs) */
-    HID_MI_INPUT,
-    0x02,
+// One bit per usage from 0 to ZMK_HID_KEYBOARD_NKRO_MAX_USAGE, padded to whole bytes.
+#define ZMK_HID_KEYBOARD_NKRO_USAGES (ZMK_HID_KEYBOARD_NKRO_MAX_USAGE + 1)
+#define ZMK_HID_KEYBOARD_NKRO_BITMAP_SIZE ((ZMK_HID_KEYBOARD_NKRO_USAGES + 7) / 8)
+#define ZMK_HID_KEYBOARD_NKRO_PADDING                                                              \
+    (ZMK_HID_KEYBOARD_NKRO_BITMAP_SIZE * 8 - ZMK_HID_KEYBOARD_NKRO_USAGES)
+
+#define ZMK_HID_CONSUMER_NKRO_SIZE CONFIG_ZMK_HID_CONSUMER_REPORT_SIZE
+
+#if IS_ENABLED(CONFIG_ZMK_HID_CONSUMER_REPORT_BITMAP)
+// Frequently used consumer usages get one bit each, other usages go into the usage array.
+#define ZMK_HID_CONSUMER_BITMAP_USAGES 16
+#define ZMK_HID_CONSUMER_BITMAP_USAGE_0 HID_USAGE_CONSUMER_PLAY_PAUSE
+#define ZMK_HID_CONSUMER_BITMAP_USAGE_1 HID_USAGE_CONSUMER_SCAN_NEXT_TRACK
+#define ZMK_HID_CONSUMER_BITMAP_USAGE_2 HID_USAGE_CONSUMER_SCAN_PREVIOUS_TRACK
+#define ZMK_HID_CONSUMER_BITMAP_USAGE_3 HID_USAGE_CONSUMER_STOP
+#define ZMK_HID_CONSUMER_BITMAP_USAGE_4 HID_USAGE_CONSUMER_MUTE
+#define ZMK_HID_CONSUMER_BITMAP_USAGE_5 HID_USAGE_CONSUMER_VOLUME_INCREMENT
+#define ZMK_HID_CONSUMER_BITMAP_USAGE_6 HID_USAGE_CONSUMER_VOLUME_DECREMENT
+#define ZMK_HID_CONSUMER_BITMAP_USAGE_7 HID_USAGE_CONSUMER_DISPLAY_BRIGHTNESS_INCREMENT
+#define ZMK_HID_CONSUMER_BITMAP_USAGE_8 HID_USAGE_CONSUMER_DISPLAY_BRIGHTNESS_DECREMENT
+#define ZMK_HID_CONSUMER_BITMAP_USAGE_9 HID_USAGE_CONSUMER_EJECT
+#define ZMK_HID_CONSUMER_BITMAP_USAGE_10 HID_USAGE_CONSUMER_FAST_FORWARD
+#define ZMK_HID_CONSUMER_BITMAP_USAGE_11 HID_USAGE_CONSUMER_REWIND
+#define ZMK_HID_CONSUMER_BITMAP_USAGE_12 HID_USAGE_CONSUMER_AL_CALCULATOR
+#define ZMK_HID_CONSUMER_BITMAP_USAGE_13 HID_USAGE_CONSUMER_AC_SEARCH
+#define ZMK_HID_CONSUMER_BITMAP_USAGE_14 HID_USAGE_CONSUMER_AC_HOME
+#define ZMK_HID_CONSUMER_BITMAP_USAGE_15 HID_USAGE_CONSUMER_AC_BACK
+
+#define ZMK_HID_CONSUMER_BITMAP_USAGE(i) UTIL_CAT(ZMK_HID_CONSUMER_BITMAP_USAGE_, i)
 
-    /* USAGE_PAGE (Keyboard/Keypad) */
-    HID_GI_USAGE_PAGE,
-    HID_USAGE_KEY,
-    /* REPORT_SIZE (8) */
-    HID_GI_REPORT_SIZE,
-    0x08,
-    /* REPORT_COUNT (1) */
-    HID_GI_REPORT_COUNT,
-    0x01,
-    /* INPUT (Cnst,Var,Abs) */
-    HID_MI_INPUT,
+// Two byte USAGE item, since some of the usages are above 0xFF.
+#define ZMK_HID_CONSUMER_BITMAP_USAGE_ITEM(i, _)                                                   \
+    HID_LI_USAGE + 1, ZMK_HID_CONSUMER_BITMAP_USAGE(i) & 0xFF,                                     \
+        ZMK_HID_CONSUMER_BITMAP_USAGE(i) >> 8,
+#endif /* IS_ENABLED(CONFIG_ZMK_HID_CONSUMER_REPORT_BITMAP) */
+
+// Num Lock, Caps Lock, Scroll Lock, Compose and Kana.
+#define ZMK_HID_NUM_INDICATORS 5
+
+typedef uint8_t zmk_hid_indicators;
+
+#define ZMK_HID_MOUSE_NUM_BUTTONS 5
+
+// Fixed frame size of the vendor defined raw HID channel, in both directions.
+#define ZMK_HID_RAW_REPORT_SIZE 32
+#define ZMK_HID_RAW_USAGE_PAGE 0xFF60
+#define ZMK_HID_RAW_USAGE 0x61
+#define ZMK_HID_RAW_USAGE_INPUT 0x62
+#define ZMK_HID_RAW_USAGE_OUTPUT 0x63
+
+// The report descriptor is assembled from one fragment per feature, so every build only describes
+// the reports it actually sends. Fragments of disabled features are empty.
+
+#define ZMK_HID_KEYBOARD_LED_DESC                                                                  \
+    /* USAGE_PAGE (LEDs) */                                                                        \
+    HID_GI_USAGE_PAGE,                                                                             \
+    HID_USAGE_LED,                                                                                 \
+    /* USAGE_MINIMUM (Num Lock) */                                                                 \
+    HID_LI_USAGE_MIN(1),                                                                           \
+    HID_USAGE_LED_NUM_LOCK,                                                                        \
+    /* USAGE_MAXIMUM (Kana) */                                                                     \
+    HID_LI_USAGE_MAX(1),                                                                           \
+    HID_USAGE_LED_KANA,                                                                            \
+    /* REPORT_SIZE (1) */                                                                          \
+    HID_GI_REPORT_SIZE,                                                                            \
+    0x01,                                                                                          \
+    /* REPORT_COUNT (ZMK_HID_NUM_INDICATORS) */                                                    \
+    HID_GI_REPORT_COUNT,                                                                           \
+    ZMK_HID_NUM_INDICATORS,                                                                        \
+    /* OUTPUT (Data,Var,Abs) */                                                                    \
+    HID_MI_OUTPUT,                                                                                 \
+    0x02,                                                                                          \
+    /* REPORT_SIZE (8 - ZMK_HID_NUM_INDICATORS) */                                                 \
+    HID_GI_REPORT_SIZE,                                                                            \
+    8 - ZMK_HID_NUM_INDICATORS,                                                                    \
+    /* REPORT_COUNT (1) */                                                                         \
+    HID_GI_REPORT_COUNT,                                                                           \
+    0x01,                                                                                          \
+    /* OUTPUT (Cnst,Var,Abs) */                                                                    \
+    HID_MI_OUTPUT,                                                                                 \
     0x03,
 
-    /* USAGE_PAGE (Keyboard/Keypad) */
-    HID_GI_USAGE_PAGE,
-    HID_USAGE_KEY,
-    /* LOGICAL_MINIMUM (0) */
-    HID_GI_LOGICAL_MIN(1),
-    0x00,
-    /* LOGICAL_MAXIMUM (0xFF) */
-    HID_GI_LOGICAL_MAX(1),
-    0xFF,
-    /* USAGE_MINIMUM (Reserved) */
-    HID_LI_USAGE_MIN(1),
+#if IS_ENABLED(CONFIG_ZMK_HID_REPORT_TYPE_NKRO)
+
+#if ZMK_HID_KEYBOARD_NKRO_PADDING > 0
+#define ZMK_HID_KEYBOARD_NKRO_PADDING_DESC                                                         \
+    /* REPORT_SIZE (1) */                                                                          \
+    HID_GI_REPORT_SIZE,                                                                            \
+    0x01,                                                                                          \
+    /* REPORT_COUNT (ZMK_HID_KEYBOARD_NKRO_PADDING) */                                             \
+    HID_GI_REPORT_COUNT,                                                                           \
+    ZMK_HID_KEYBOARD_NKRO_PADDING,                                                                 \
+    /* INPUT (Cnst,Var,Abs) */                                                                     \
+    HID_MI_INPUT,                                                                                  \
+    0x03,
+#else
+#define ZMK_HID_KEYBOARD_NKRO_PADDING_DESC
+#endif
+
+#if ZMK_HID_KEYBOARD_NKRO_OVERFLOW_SIZE > 0
+#define ZMK_HID_KEYBOARD_NKRO_OVERFLOW_DESC                                                        \
+    /* LOGICAL_MINIMUM (0) */                                                                      \
+    HID_GI_LOGICAL_MIN(1),                                                                         \
+    0x00,                                                                                          \
+    /* LOGICAL_MAXIMUM (0xFF) */                                                                   \
+    HID_GI_LOGICAL_MAX(1),                                                                         \
+    0xFF,                                                                                          \
+    /* USAGE_MINIMUM (Reserved) */                                                                 \
+    HID_LI_USAGE_MIN(1),                                                                           \
+    0x00,                                                                                          \
+    /* USAGE_MAXIMUM (Keyboard Application) */                                                     \
+    HID_LI_USAGE_MAX(1),                                                                           \
+    0xFF,                                                                                          \
+    /* REPORT_SIZE (8) */                                                                          \
+    HID_GI_REPORT_SIZE,                                                                            \
+    0x08,                                                                                          \
+    /* REPORT_COUNT (ZMK_HID_KEYBOARD_NKRO_OVERFLOW_SIZE) */                                       \
+    HID_GI_REPORT_COUNT,                                                                           \
+    ZMK_HID_KEYBOARD_NKRO_OVERFLOW_SIZE,                                                           \
+    /* INPUT (Data,Ary,Abs) */                                                                     \
+    HID_MI_INPUT,                                                                                  \
     0x00,
-    /* USAGE_MAXIMUM (Keyboard Application) */
-    HID_LI_USAGE_MAX(1),
-    0xFF,
-    /* REPORT_SIZE (1) */
-    HID_GI_REPORT_SIZE,
-    0x08,
-    /* REPORT_COUNT (ZMK_HID_KEYBOARD_NKRO_SIZE) */
-    HID_GI_REPORT_COUNT,
-    ZMK_HID_KEYBOARD_NKRO_SIZE,
-    /* INPUT (Data,Ary,Abs) */
-    HID_MI_INPUT,
+#else
+#define ZMK_HID_KEYBOARD_NKRO_OVERFLOW_DESC
+#endif
+
+#define ZMK_HID_KEYBOARD_KEYS_DESC                                                                 \
+    /* USAGE_PAGE (Keyboard/Keypad) */                                                             \
+    HID_GI_USAGE_PAGE,                                                                             \
+    HID_USAGE_KEY,                                                                                 \
+    /* LOGICAL_MINIMUM (0) */                                                                      \
+    HID_GI_LOGICAL_MIN(1),                                                                         \
+    0x00,                                                                                          \
+    /* LOGICAL_MAXIMUM (1) */                                                                      \
+    HID_GI_LOGICAL_MAX(1),                                                                         \
+    0x01,                                                                                          \
+    /* USAGE_MINIMUM (Reserved) */                                                                 \
+    HID_LI_USAGE_MIN(1),                                                                           \
+    0x00,                                                                                          \
+    /* USAGE_MAXIMUM (ZMK_HID_KEYBOARD_NKRO_MAX_USAGE) */                                          \
+    HID_LI_USAGE_MAX(1),                                                                           \
+    ZMK_HID_KEYBOARD_NKRO_MAX_USAGE,                                                               \
+    /* REPORT_SIZE (1) */                                                                          \
+    HID_GI_REPORT_SIZE,                                                                            \
+    0x01,                                                                                          \
+    /* REPORT_COUNT (ZMK_HID_KEYBOARD_NKRO_USAGES) */                                              \
+    HID_GI_REPORT_COUNT,                                                                           \
+    ZMK_HID_KEYBOARD_NKRO_USAGES,                                                                  \
+    /* INPUT (Data,Var,Abs) */                                                                     \
+    HID_MI_INPUT,                                                                                  \
+    0x02,                                                                                          \
+    ZMK_HID_KEYBOARD_NKRO_PADDING_DESC                                                             \
+    ZMK_HID_KEYBOARD_NKRO_OVERFLOW_DESC
+
+#else
+
+#define ZMK_HID_KEYBOARD_KEYS_DESC                                                                 \
+    /* USAGE_PAGE (Keyboard/Keypad) */                                                             \
+    HID_GI_USAGE_PAGE,                                                                             \
+    HID_USAGE_KEY,                                                                                 \
+    /* LOGICAL_MINIMUM (0) */                                                                      \
+    HID_GI_LOGICAL_MIN(1),                                                                         \
+    0x00,                                                                                          \
+    /* LOGICAL_MAXIMUM (0xFF) */                                                                   \
+    HID_GI_LOGICAL_MAX(1),                                                                         \
+    0xFF,                                                                                          \
+    /* USAGE_MINIMUM (Reserved) */                                                                 \
+    HID_LI_USAGE_MIN(1),                                                                           \
+    0x00,                                                                                          \
+    /* USAGE_MAXIMUM (Keyboard Application) */                                                     \
+    HID_LI_USAGE_MAX(1),                                                                           \
+    0xFF,                                                                                          \
+    /* REPORT_SIZE (1) */                                                                          \
+    HID_GI_REPORT_SIZE,                                                                            \
+    0x08,                                                                                          \
+    /* REPORT_COUNT (ZMK_HID_KEYBOARD_NKRO_SIZE) */                                                \
+    HID_GI_REPORT_COUNT,                                                                           \
+    ZMK_HID_KEYBOARD_NKRO_SIZE,                                                                    \
+    /* INPUT (Data,Ary,Abs) */                                                                     \
+    HID_MI_INPUT,                                                                                  \
     0x00,
 
-    /* END_COLLECTION */
+#endif /* IS_ENABLED(CONFIG_ZMK_HID_REPORT_TYPE_NKRO) */
+
+#define ZMK_HID_KEYBOARD_DESC                                                                      \
+    /* USAGE_PAGE (Generic Desktop) */                                                             \
+    HID_GI_USAGE_PAGE,                                                                             \
+    HID_USAGE_GD,                                                                                  \
+    /* USAGE (Keyboard) */                                                                         \
+    HID_LI_USAGE,                                                                                  \
+    HID_USAGE_GD_KEYBOARD,                                                                         \
+    /* COLLECTION (Application) */                                                                 \
+    HID_MI_COLLECTION,                                                                             \
+    COLLECTION_APPLICATION,                                                                        \
+    /* REPORT ID (ZMK_HID_REPORT_ID_KEYBOARD) */                                                   \
+    HID_GI_REPORT_ID,                                                                              \
+    ZMK_HID_REPORT_ID_KEYBOARD,                                                                    \
+    /* USAGE_PAGE (Keyboard/Keypad) */                                                             \
+    HID_GI_USAGE_PAGE,                                                                             \
+    HID_USAGE_KEY,                                                                                 \
+    /* USAGE_MINIMUM (Keyboard LeftControl) */                                                     \
+    HID_LI_USAGE_MIN(1),                                                                           \
+    HID_USAGE_KEY_KEYBOARD_LEFTCONTROL,                                                            \
+    /* USAGE_MAXIMUM (Keyboard Right GUI) */                                                       \
+    HID_LI_USAGE_MAX(1),                                                                           \
+    HID_USAGE_KEY_KEYBOARD_RIGHT_GUI,                                                              \
+    /* LOGICAL_MINIMUM (0) */                                                                      \
+    HID_GI_LOGICAL_MIN(1),                                                                         \
+    0x00,                                                                                          \
+    /* LOGICAL_MAXIMUM (1) */                                                                      \
+    HID_GI_LOGICAL_MAX(1),                                                                         \
+    0x01,                                                                                          \
+    /* REPORT_SIZE (1) */                                                                          \
+    HID_GI_REPORT_SIZE,                                                                            \
+    0x01,                                                                                          \
+    /* REPORT_COUNT (8) */                                                                         \
+    HID_GI_REPORT_COUNT,                                                                           \
+    0x08,                                                                                          \
+    /* INPUT (Data,Var,Abs) */                                                                     \
+    HID_MI_INPUT,                                                                                  \
+    0x02,                                                                                          \
+    /* USAGE_PAGE (Keyboard/Keypad) */                                                             \
+    HID_GI_USAGE_PAGE,                                                                             \
+    HID_USAGE_KEY,                                                                                 \
+    /* REPORT_SIZE (8) */                                                                          \
+    HID_GI_REPORT_SIZE,                                                                            \
+    0x08,                                                                                          \
+    /* REPORT_COUNT (1) */                                                                         \
+    HID_GI_REPORT_COUNT,                                                                           \
+    0x01,                                                                                          \
+    /* INPUT (Cnst,Var,Abs) */                                                                     \
+    HID_MI_INPUT,                                                                                  \
+    0x03,                                                                                          \
+    ZMK_HID_KEYBOARD_LED_DESC                                                                      \
+    ZMK_HID_KEYBOARD_KEYS_DESC                                                                     \
+    /* END_COLLECTION */                                                                           \
     HID_MI_COLLECTION_END,
-    /* USAGE_PAGE (Consumer) */
-    HID_GI_USAGE_PAGE,
-    HID_USAGE_CONSUMER,
-    /* USAGE (Consumer Control) */
-    HID_LI_USAGE,
-    HID_USAGE_CONSUMER_CONSUMER_CONTROL,
-    /* Consumer Page */
-    HID_MI_COLLECTION,
-    COLLECTION_APPLICATION,
-    /* REPORT ID (1) */
-    HID_GI_REPORT_ID,
+
+#if IS_ENABLED(CONFIG_ZMK_HID_CONSUMER_REPORT_BITMAP)
+#define ZMK_HID_CONSUMER_BITMAP_DESC                                                               \
+    /* LOGICAL_MINIMUM (0) */                                                                      \
+    HID_GI_LOGICAL_MIN(1),                                                                         \
+    0x00,                                                                                          \
+    /* LOGICAL_MAXIMUM (1) */                                                                      \
+    HID_GI_LOGICAL_MAX(1),                                                                         \
+    0x01,                                                                                          \
+    /* REPORT_SIZE (1) */                                                                          \
+    HID_GI_REPORT_SIZE,                                                                            \
+    0x01,                                                                                          \
+    /* REPORT_COUNT (ZMK_HID_CONSUMER_BITMAP_USAGES) */                                            \
+    HID_GI_REPORT_COUNT,                                                                           \
+    ZMK_HID_CONSUMER_BITMAP_USAGES,                                                                \
+    UTIL_LISTIFY(ZMK_HID_CONSUMER_BITMAP_USAGES, ZMK_HID_CONSUMER_BITMAP_USAGE_ITEM, _)            \
+    /* INPUT (Data,Var,Abs) */                                                                     \
+    HID_MI_INPUT,                                                                                  \
     0x02,
-    /* USAGE_PAGE (Consumer) */
-    HID_GI_USAGE_PAGE,
-    HID_USAGE_CONSUMER,
-    /* LOGICAL_MINIMUM (0) */
-    HID_GI_LOGICAL_MIN(1),
-    0x00,
-    /* LOGICAL_MAXIMUM (0xFFFF) */
-    HID_GI_LOGICAL_MAX(2),
-    0xFF,
-    0xFF,
-    HID_LI_USAGE_MIN(1),
-    0x00,
-    /* USAGE_MAXIMUM (0xFFFF) */
-    HID_LI_USAGE_MAX(2),
-    0xFF,
-    0xFF,
-    /* INPUT (Data,Ary,Abs) */
-    /* REPORT_SIZE (16) */
-    HID_GI_REPORT_SIZE,
-    0x10,
-    /* REPORT_COUNT (ZMK_HID_CONSUMER_NKRO_SIZE) */
-    HID_GI_REPORT_COUNT,
-    ZMK_HID_CONSUMER_NKRO_SIZE,
-    HID_MI_INPUT,
-    0x00,
-    /* END COLLECTION */
+#else
+#define ZMK_HID_CONSUMER_BITMAP_DESC
+#endif /* IS_ENABLED(CONFIG_ZMK_HID_CONSUMER_REPORT_BITMAP) */
+
+#define ZMK_HID_CONSUMER_DESC                                                                      \
+    /* USAGE_PAGE (Consumer) */                                                                    \
+    HID_GI_USAGE_PAGE,                                                                             \
+    HID_USAGE_CONSUMER,                                                                            \
+    /* USAGE (Consumer Control) */                                                                 \
+    HID_LI_USAGE,                                                                                  \
+    HID_USAGE_CONSUMER_CONSUMER_CONTROL,                                                           \
+    /* Consumer Page */                                                                            \
+    HID_MI_COLLECTION,                                                                             \
+    COLLECTION_APPLICATION,                                                                        \
+    /* REPORT ID (ZMK_HID_REPORT_ID_CONSUMER) */                                                   \
+    HID_GI_REPORT_ID,                                                                              \
+    ZMK_HID_REPORT_ID_CONSUMER,                                                                    \
+    /* USAGE_PAGE (Consumer) */                                                                    \
+    HID_GI_USAGE_PAGE,                                                                             \
+    HID_USAGE_CONSUMER,                                                                            \
+    ZMK_HID_CONSUMER_BITMAP_DESC                                                                   \
+    /* LOGICAL_MINIMUM (0) */                                                                      \
+    HID_GI_LOGICAL_MIN(1),                                                                         \
+    0x00,                                                                                          \
+    /* LOGICAL_MAXIMUM (0xFFFF) */                                                                 \
+    HID_GI_LOGICAL_MAX(2),                                                                         \
+    0xFF,                                                                                          \
+    0xFF,                                                                                          \
+    HID_LI_USAGE_MIN(1),                                                                           \
+    0x00,                                                                                          \
+    /* USAGE_MAXIMUM (0xFFFF) */                                                                   \
+    HID_LI_USAGE_MAX(2),                                                                           \
+    0xFF,                                                                                          \
+    0xFF,                                                                                          \
+    /* INPUT (Data,Ary,Abs) */                                                                     \
+    /* REPORT_SIZE (16) */                                                                         \
+    HID_GI_REPORT_SIZE,                                                                            \
+    0x10,                                                                                          \
+    /* REPORT_COUNT (ZMK_HID_CONSUMER_NKRO_SIZE) */                                                \
+    HID_GI_REPORT_COUNT,                                                                           \
+    ZMK_HID_CONSUMER_NKRO_SIZE,                                                                    \
+    HID_MI_INPUT,                                                                                  \
+    0x00,                                                                                          \
+    /* END COLLECTION */                                                                           \
     HID_MI_COLLECTION_END,
-};
 
-// struct zmk_hid_boot_report
-// {
-//     uint8_t modifiers;
-//     uint8_t _unused;
-//     uint8_t keys[6];
-// } __packed;
+#if IS_ENABLED(CONFIG_ZMK_MOUSE)
+#define ZMK_HID_MOUSE_DESC                                                                         \
+    /* USAGE_PAGE (Generic Desktop) */                                                             \
+    HID_GI_USAGE_PAGE,                                                                             \
+    HID_USAGE_GD,                                                                                  \
+    /* USAGE (Mouse) */                                                                            \
+    HID_LI_USAGE,                                                                                  \
+    HID_USAGE_GD_MOUSE,                                                                            \
+    /* COLLECTION (Application) */                                                                 \
+    HID_MI_COLLECTION,                                                                             \
+    COLLECTION_APPLICATION,                                                                        \
+    /* REPORT ID (ZMK_HID_REPORT_ID_MOUSE) */                                                      \
+    HID_GI_REPORT_ID,                                                                              \
+    ZMK_HID_REPORT_ID_MOUSE,                                                                       \
+    /* USAGE (Pointer) */                                                                          \
+    HID_LI_USAGE,                                                                                  \
+    HID_USAGE_GD_POINTER,                                                                          \
+    /* COLLECTION (Physical) */                                                                    \
+    HID_MI_COLLECTION,                                                                             \
+    COLLECTION_PHYSICAL,                                                                           \
+    /* USAGE_PAGE (Button) */                                                                      \
+    HID_GI_USAGE_PAGE,                                                                             \
+    HID_USAGE_BUTTON,                                                                              \
+    /* USAGE_MINIMUM (Button 1) */                                                                 \
+    HID_LI_USAGE_MIN(1),                                                                           \
+    0x01,                                                                                          \
+    /* USAGE_MAXIMUM (Button ZMK_HID_MOUSE_NUM_BUTTONS) */                                         \
+    HID_LI_USAGE_MAX(1),                                                                           \
+    ZMK_HID_MOUSE_NUM_BUTTONS,                                                                     \
+    /* LOGICAL_MINIMUM (0) */                                                                      \
+    HID_GI_LOGICAL_MIN(1),                                                                         \
+    0x00,                                                                                          \
+    /* LOGICAL_MAXIMUM (1) */                                                                      \
+    HID_GI_LOGICAL_MAX(1),                                                                         \
+    0x01,                                                                                          \
+    /* REPORT_SIZE (1) */                                                                          \
+    HID_GI_REPORT_SIZE,                                                                            \
+    0x01,                                                                                          \
+    /* REPORT_COUNT (ZMK_HID_MOUSE_NUM_BUTTONS) */                                                 \
+    HID_GI_REPORT_COUNT,                                                                           \
+    ZMK_HID_MOUSE_NUM_BUTTONS,                                                                     \
+    /* INPUT (Data,Var,Abs) */                                                                     \
+    HID_MI_INPUT,                                                                                  \
+    0x02,                                                                                          \
+    /* REPORT_SIZE (8 - ZMK_HID_MOUSE_NUM_BUTTONS) */                                              \
+    HID_GI_REPORT_SIZE,                                                                            \
+    8 - ZMK_HID_MOUSE_NUM_BUTTONS,                                                                 \
+    /* REPORT_COUNT (1) */                                                                         \
+    HID_GI_REPORT_COUNT,                                                                           \
+    0x01,                                                                                          \
+    /* INPUT (Cnst,Var,Abs) */                                                                     \
+    HID_MI_INPUT,                                                                                  \
+    0x03,                                                                                          \
+    /* USAGE_PAGE (Generic Desktop) */                                                             \
+    HID_GI_USAGE_PAGE,                                                                             \
+    HID_USAGE_GD,                                                                                  \
+    /* USAGE (X) */                                                                                \
+    HID_LI_USAGE,                                                                                  \
+    HID_USAGE_GD_X,                                                                                \
+    /* USAGE (Y) */                                                                                \
+    HID_LI_USAGE,                                                                                  \
+    HID_USAGE_GD_Y,                                                                                \
+    /* USAGE (Wheel) */                                                                            \
+    HID_LI_USAGE,                                                                                  \
+    HID_USAGE_GD_WHEEL,                                                                            \
+    /* LOGICAL_MINIMUM (-127) */                                                                   \
+    HID_GI_LOGICAL_MIN(1),                                                                         \
+    0x81,                                                                                          \
+    /* LOGICAL_MAXIMUM (127) */                                                                    \
+    HID_GI_LOGICAL_MAX(1),                                                                         \
+    0x7F,                                                                                          \
+    /* REPORT_SIZE (8) */                                                                          \
+    HID_GI_REPORT_SIZE,                                                                            \
+    0x08,                                                                                          \
+    /* REPORT_COUNT (3) */                                                                         \
+    HID_GI_REPORT_COUNT,                                                                           \
+    0x03,                                                                                          \
+    /* INPUT (Data,Var,Rel) */                                                                     \
+    HID_MI_INPUT,                                                                                  \
+    0x06,                                                                                          \
+    /* USAGE_PAGE (Consumer) */                                                                    \
+    HID_GI_USAGE_PAGE,                                                                             \
+    HID_USAGE_CONSUMER,                                                                            \
+    /* USAGE (AC Pan) */                                                                           \
+    HID_LI_USAGE + 1,                                                                              \
+    HID_USAGE_CONSUMER_AC_PAN & 0xFF,                                                              \
+    HID_USAGE_CONSUMER_AC_PAN >> 8,                                                                \
+    /* LOGICAL_MINIMUM (-127) */                                                                   \
+    HID_GI_LOGICAL_MIN(1),                                                                         \
+    0x81,                                                                                          \
+    /* LOGICAL_MAXIMUM (127) */                                                                    \
+    HID_GI_LOGICAL_MAX(1),                                                                         \
+    0x7F,                                                                                          \
+    /* REPORT_SIZE (8) */                                                                          \
+    HID_GI_REPORT_SIZE,                                                                            \
+    0x08,                                                                                          \
+    /* REPORT_COUNT (1) */                                                                         \
+    HID_GI_REPORT_COUNT,                                                                           \
+    0x01,                                                                                          \
+    /* INPUT (Data,Var,Rel) */                                                                     \
+    HID_MI_INPUT,                                                                                  \
+    0x06,                                                                                          \
+    /* END COLLECTION */                                                                           \
+    HID_MI_COLLECTION_END,                                                                         \
+    /* END COLLECTION */                                                                           \
+    HID_MI_COLLECTION_END,
+#else
+#define ZMK_HID_MOUSE_DESC
+#endif /* IS_ENABLED(CONFIG_ZMK_MOUSE) */
+
+#if IS_ENABLED(CONFIG_ZMK_RAW_HID)
+#define ZMK_HID_RAW_DESC                                                                           \
+    /* USAGE_PAGE (Vendor Defined ZMK_HID_RAW_USAGE_PAGE) */                                       \
+    HID_GI_USAGE_PAGE + 1,                                                                         \
+    ZMK_HID_RAW_USAGE_PAGE & 0xFF,                                                                 \
+    ZMK_HID_RAW_USAGE_PAGE >> 8,                                                                   \
+    /* USAGE (ZMK_HID_RAW_USAGE) */                                                                \
+    HID_LI_USAGE,                                                                                  \
+    ZMK_HID_RAW_USAGE,                                                                             \
+    /* COLLECTION (Application) */                                                                 \
+    HID_MI_COLLECTION,                                                                             \
+    COLLECTION_APPLICATION,                                                                        \
+    /* REPORT ID (ZMK_HID_REPORT_ID_RAW) */                                                        \
+    HID_GI_REPORT_ID,                                                                              \
+    ZMK_HID_REPORT_ID_RAW,                                                                         \
+    /* LOGICAL_MINIMUM (0) */                                                                      \
+    HID_GI_LOGICAL_MIN(1),                                                                         \
+    0x00,                                                                                          \
+    /* LOGICAL_MAXIMUM (255) */                                                                    \
+    HID_GI_LOGICAL_MAX(2),                                                                         \
+    0xFF,                                                                                          \
+    0x00,                                                                                          \
+    /* REPORT_SIZE (8) */                                                                          \
+    HID_GI_REPORT_SIZE,                                                                            \
+    0x08,                                                                                          \
+    /* REPORT_COUNT (ZMK_HID_RAW_REPORT_SIZE) */                                                   \
+    HID_GI_REPORT_COUNT,                                                                           \
+    ZMK_HID_RAW_REPORT_SIZE,                                                                       \
+    /* USAGE (ZMK_HID_RAW_USAGE_INPUT) */                                                          \
+    HID_LI_USAGE,                                                                                  \
+    ZMK_HID_RAW_USAGE_INPUT,                                                                       \
+    /* INPUT (Data,Var,Abs) */                                                                     \
+    HID_MI_INPUT,                                                                                  \
+    0x02,                                                                                          \
+    /* USAGE (ZMK_HID_RAW_USAGE_OUTPUT) */                                                         \
+    HID_LI_USAGE,                                                                                  \
+    ZMK_HID_RAW_USAGE_OUTPUT,                                                                      \
+    /* OUTPUT (Data,Var,Abs) */                                                                    \
+    HID_MI_OUTPUT,                                                                                 \
+    0x02,                                                                                          \
+    /* END COLLECTION */                                                                           \
+    HID_MI_COLLECTION_END,
+#else
+#define ZMK_HID_RAW_DESC
+#endif /* IS_ENABLED(CONFIG_ZMK_RAW_HID) */
+
+static const uint8_t zmk_hid_report_desc[] = {
+    ZMK_HID_KEYBOARD_DESC ZMK_HID_CONSUMER_DESC ZMK_HID_MOUSE_DESC ZMK_HID_RAW_DESC};
+
+#define ZMK_HID_BOOT_KEYBOARD_SIZE 6
+
+// Sent without a report ID while the host has selected the boot protocol, e.g. a BIOS or KVM.
+struct zmk_hid_boot_report {
+    zmk_mod_flags modifiers;
+    uint8_t _reserved;
+    uint8_t keys[ZMK_HID_BOOT_KEYBOARD_SIZE];
+} __packed;
 
 struct zmk_hid_keyboard_report_body {
     zmk_mod_flags modifiers;
     uint8_t _reserved;
+#if IS_ENABLED(CONFIG_ZMK_HID_REPORT_TYPE_NKRO)
+    uint8_t keys[ZMK_HID_KEYBOARD_NKRO_BITMAP_SIZE];
+#if ZMK_HID_KEYBOARD_NKRO_OVERFLOW_SIZE > 0
+    uint8_t overflow[ZMK_HID_KEYBOARD_NKRO_OVERFLOW_SIZE];
+#endif
+#else
     uint8_t keys[ZMK_HID_KEYBOARD_NKRO_SIZE];
+#endif
 } __packed;
 
 struct zmk_hid_keyboard_report {
@@ -157,7 +525,20 @@ struct zmk_hid_keyboard_report {
     struct zmk_hid_keyboard_report_body body;
 } __packed;
 
+// Sent by the host with its lock state, e.g. to light up the Caps Lock LED.
+struct zmk_hid_led_report_body {
+    zmk_hid_indicators indicators;
+} __packed;
+
+struct zmk_hid_led_report {
+    uint8_t report_id;
+    struct zmk_hid_led_report_body body;
+} __packed;
+
 struct zmk_hid_consumer_report_body {
+#if IS_ENABLED(CONFIG_ZMK_HID_CONSUMER_REPORT_BITMAP)
+    uint16_t bitmap;
+#endif
     uint16_t keys[ZMK_HID_CONSUMER_NKRO_SIZE];
 } __packed;
 
@@ -166,10 +547,34 @@ struct zmk_hid_consumer_report {
     struct zmk_hid_consumer_report_body body;
 } __packed;
 
+struct zmk_hid_mouse_report_body {
+    zmk_mouse_button_flags buttons;
+    int8_t x;
+    int8_t y;
+    int8_t scroll_y;
+    int8_t scroll_x;
+} __packed;
+
+struct zmk_hid_mouse_report {
+    uint8_t report_id;
+    struct zmk_hid_mouse_report_body body;
+} __packed;
+
+struct zmk_hid_raw_report_body {
+    uint8_t data[ZMK_HID_RAW_REPORT_SIZE];
+} __packed;
+
+struct zmk_hid_raw_report {
+    uint8_t report_id;
+    struct zmk_hid_raw_report_body body;
+} __packed;
+
 int zmk_hid_register_mod(zmk_mod modifier);
 int zmk_hid_unregister_mod(zmk_mod modifier);
-int zmk_hid_implicit_modifiers_press(zmk_mod_flags implicit_modifiers);
-int zmk_hid_implicit_modifiers_release();
+int zmk_hid_implicit_modifiers_press(uint8_t usage_page, zmk_key key,
+                                     zmk_mod_flags implicit_modifiers);
+int zmk_hid_implicit_modifiers_release(uint8_t usage_page, zmk_key key);
+zmk_mod_flags zmk_hid_get_implicit_modifiers();
 int zmk_hid_keyboard_press(zmk_key key);
 int zmk_hid_keyboard_release(zmk_key key);
 void zmk_hid_keyboard_clear();
@@ -178,5 +583,38 @@ int zmk_hid_consumer_press(zmk_key key);
 int zmk_hid_consumer_release(zmk_key key);
 void zmk_hid_consumer_clear();
 
+#if IS_ENABLED(CONFIG_ZMK_MOUSE)
+int zmk_hid_mouse_buttons_press(zmk_mouse_button_flags buttons);
+int zmk_hid_mouse_buttons_release(zmk_mouse_button_flags buttons);
+void zmk_hid_mouse_movement_set(int8_t x, int8_t y);
+void zmk_hid_mouse_scroll_set(int8_t scroll_x, int8_t scroll_y);
+void zmk_hid_mouse_clear();
+#endif /* IS_ENABLED(CONFIG_ZMK_MOUSE) */
+
+bool zmk_hid_keyboard_report_changed();
+void zmk_hid_keyboard_report_sent();
+bool zmk_hid_consumer_report_changed();
+void zmk_hid_consumer_report_sent();
+void zmk_hid_reports_invalidate();
+// Whether a queued report can be replaced by a newer one of the same length without hiding a
+// change from the host, given the report sent before the queued one.
+bool zmk_hid_report_can_supersede(const uint8_t *previous, const uint8_t *queued,
+                                  const uint8_t *report, size_t len);
+
+#if IS_ENABLED(CONFIG_ZMK_MOUSE)
+// Mouse reports carry movement deltas, so queued ones are combined rather than replaced. A report
+// can absorb an earlier one if both have the same buttons and the summed movement fits.
+bool zmk_hid_mouse_report_can_merge(const struct zmk_hid_mouse_report_body *report,
+                                    const struct zmk_hid_mouse_report_body *earlier);
+// Adds the movement of an earlier report to a later one, saturating, and keeps the later buttons.
+void zmk_hid_mouse_report_merge(struct zmk_hid_mouse_report_body *report,
+                                const struct zmk_hid_mouse_report_body *earlier);
+#endif /* IS_ENABLED(CONFIG_ZMK_MOUSE) */
+
 struct zmk_hid_keyboard_report *zmk_hid_get_keyboard_report();
+struct zmk_hid_boot_report *zmk_hid_get_boot_report();
 struct zmk_hid_consumer_report *zmk_hid_get_consumer_report();
+
+#if IS_ENABLED(CONFIG_ZMK_MOUSE)
+struct zmk_hid_mouse_report *zmk_hid_get_mouse_report();
+#endif /* IS_ENABLED(CONFIG_ZMK_MOUSE) */
@@ -0,0 +1,22 @@
+/*
+ * Copyright (c) 2020 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <zmk/endpoints.h>
+#include <zmk/hid.h>
+
+// Bit n is the LED usage n + 1 from the HID LED page, as in the keyboard output report.
+#define ZMK_HID_INDICATORS_NUM_LOCK BIT(HID_USAGE_LED_NUM_LOCK - 1)
+#define ZMK_HID_INDICATORS_CAPS_LOCK BIT(HID_USAGE_LED_CAPS_LOCK - 1)
+#define ZMK_HID_INDICATORS_SCROLL_LOCK BIT(HID_USAGE_LED_SCROLL_LOCK - 1)
+#define ZMK_HID_INDICATORS_COMPOSE BIT(HID_USAGE_LED_COMPOSE - 1)
+#define ZMK_HID_INDICATORS_KANA BIT(HID_USAGE_LED_KANA - 1)
+
+zmk_hid_indicators zmk_hid_indicators_get_current();
+
+void zmk_hid_indicators_process_report(enum zmk_endpoint endpoint, zmk_hid_indicators indicators);
+void zmk_hid_indicators_endpoint_changed();
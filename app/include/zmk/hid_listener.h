@@ -0,0 +1,13 @@
+/*
+ * Copyright (c) 2020 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <zephyr.h>
+
+// Sends a release and a new press of a usage that is currently pressed, through the same reports
+// as keycode state changes, without raising any event for them.
+int zmk_hid_listener_resend_usage(uint8_t usage_page, uint32_t keycode);
@@ -6,6 +6,8 @@
 
 #pragma once
 
+#include <bluetooth/conn.h>
+
 #include <zmk/keys.h>
 #include <zmk/hid.h>
 
@@ -13,3 +15,32 @@ int zmk_hog_init();
 
 int zmk_hog_send_keyboard_report(struct zmk_hid_keyboard_report_body *body);
 int zmk_hog_send_consumer_report(struct zmk_hid_consumer_report_body *body);
+// Hosts in the boot protocol get the boot keyboard report instead of the keyboard report, and no
+// consumer or mouse reports.
+bool zmk_hog_is_boot_protocol(struct bt_conn *conn);
+// Send reports to the hosts of all connected profiles instead of only the active one.
+void zmk_hog_set_broadcast(bool enable);
+
+// Report notifications to a host since it connected.
+struct zmk_hog_stats {
+    uint32_t notify_sent;
+    // Notifications the stack rejected, including those retried because it was out of buffers.
+    uint32_t notify_failed;
+    uint8_t queue_depth;
+    uint8_t max_queue_depth;
+    // Time from handing a notification to the stack until it completed.
+    uint32_t latency_count;
+    uint32_t latency_min_us;
+    uint32_t latency_max_us;
+    uint64_t latency_total_us;
+};
+
+int zmk_hog_get_stats(struct bt_conn *conn, struct zmk_hog_stats *stats);
+
+#if IS_ENABLED(CONFIG_ZMK_RAW_HID)
+int zmk_hog_send_raw_report(struct bt_conn *conn, const struct zmk_hid_raw_report_body *report);
+#endif /* IS_ENABLED(CONFIG_ZMK_RAW_HID) */
+
+#if IS_ENABLED(CONFIG_ZMK_MOUSE)
+int zmk_hog_send_mouse_report(struct zmk_hid_mouse_report_body *body);
+#endif /* IS_ENABLED(CONFIG_ZMK_MOUSE) */
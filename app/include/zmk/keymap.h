@@ -6,6 +6,8 @@
 
 #pragma once
 
+#include <zmk/behavior.h>
+
 typedef uint32_t zmk_keymap_layers_state;
 
 uint8_t zmk_keymap_layer_default();
@@ -16,4 +18,9 @@ int zmk_keymap_layer_activate(uint8_t layer);
 int zmk_keymap_layer_deactivate(uint8_t layer);
 int zmk_keymap_layer_toggle(uint8_t layer);
 
+uint8_t zmk_keymap_layer_count();
+int zmk_keymap_get_binding(uint8_t layer, uint32_t position, struct zmk_behavior_binding *binding);
+int zmk_keymap_set_binding(uint8_t layer, uint32_t position,
+                           const struct zmk_behavior_binding *binding);
+
 int zmk_keymap_position_state_changed(uint32_t position, bool pressed, int64_t timestamp);
@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2020 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <zephyr.h>
+
+#define ZMK_LATENCY_BUCKETS 16
+
+// Latency from a key state change being scanned until the report carrying it was delivered.
+struct zmk_latency_stats {
+    uint32_t count;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint64_t total_us;
+    // Bucket i counts samples in [2^i, 2^(i + 1)) us. The first bucket also counts samples below
+    // 1 us and the last one everything above its range.
+    uint32_t buckets[ZMK_LATENCY_BUCKETS];
+};
+
+#ifdef CONFIG_ZMK_LATENCY_STATS
+
+void zmk_latency_scan_detected();
+// Called once all scanned events have been handled, which drops a scan no report claimed.
+void zmk_latency_scan_processed();
+// Keeps the pending scan past the end of its processing, until the reports it caused have been
+// sent, e.g. after being combined. Releasing drops the scan if none of them claimed it.
+void zmk_latency_hold_scan();
+void zmk_latency_release_scan();
+bool zmk_latency_claim_scan(uint32_t *scan_time);
+void zmk_latency_report_delivered(uint32_t scan_time);
+
+void zmk_latency_get_stats(struct zmk_latency_stats *stats);
+void zmk_latency_reset();
+
+#else
+
+static inline void zmk_latency_scan_detected() {}
+static inline void zmk_latency_scan_processed() {}
+static inline void zmk_latency_hold_scan() {}
+static inline void zmk_latency_release_scan() {}
+static inline bool zmk_latency_claim_scan(uint32_t *scan_time) { return false; }
+static inline void zmk_latency_report_delivered(uint32_t scan_time) {}
+
+#endif /* CONFIG_ZMK_LATENCY_STATS */
@@ -0,0 +1,25 @@
+/*
+ * Copyright (c) 2020 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <zephyr.h>
+#include <dt-bindings/zmk/mouse.h>
+
+typedef uint8_t zmk_mouse_button_flags;
+typedef uint16_t zmk_mouse_button;
+
+struct vector2d {
+    int16_t x;
+    int16_t y;
+};
+
+struct zmk_mouse_move_config {
+    // Time from the first key press until the maximum speed is reached.
+    uint16_t time_to_max_speed_ms;
+    // Shape of the acceleration curve. 0 is constant speed, 1 linear, 2 quadratic and so on.
+    uint8_t acceleration_exponent;
+};
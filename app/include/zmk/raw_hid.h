@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2020 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <zmk/endpoints.h>
+#include <zmk/hid.h>
+
+#define ZMK_RAW_HID_PROTOCOL_VERSION 1
+
+// Every frame starts with the command and a tag chosen by the host, which the response echoes.
+// Responses add a status byte, followed by the payload. Multi-byte values are little endian.
+enum zmk_raw_hid_command {
+    // Response: protocol version (u8), frame size (u8), layer count (u8), key positions (u16).
+    ZMK_RAW_HID_CMD_GET_VERSION = 0x01,
+    // Response: sample count, min, max and average latency in us (u32 each).
+    ZMK_RAW_HID_CMD_GET_LATENCY = 0x02,
+    // Request: first bucket (u8). Response: first bucket (u8), bucket count (u8), counts (u32).
+    ZMK_RAW_HID_CMD_GET_LATENCY_HISTOGRAM = 0x03,
+    ZMK_RAW_HID_CMD_RESET_LATENCY = 0x04,
+    // Removes the oldest trace entries. Response: entries dropped since the last read (u8),
+    // entry count (u8), entries of timestamp in ms (u32), type (u8), state (u8), usage page (u8)
+    // and value (u16), which is the position, keycode or layer.
+    ZMK_RAW_HID_CMD_READ_TRACE = 0x05,
+    // Request: layer (u8), position (u16).
+    // Response: param1 (u32), param2 (u32), behavior name (null terminated).
+    ZMK_RAW_HID_CMD_GET_BINDING = 0x06,
+    // Request: layer (u8), position (u16), param1 (u32), param2 (u32), behavior name (null
+    // terminated). The binding is replaced until the next reboot.
+    ZMK_RAW_HID_CMD_SET_BINDING = 0x07,
+    // Request: BLE profile (u8, 0xFF for the active one). Response: profile (u8), interval,
+    // latency, timeout (u16 each), TX and RX PHY (u8 each), TX and RX data length, parameter and
+    // PHY update counts (u16 each).
+    ZMK_RAW_HID_CMD_GET_BLE_LINK = 0x08,
+    // Request: BLE profile (u8, 0xFF for the active one). Response: profile (u8), notifications
+    // sent and failed (u32 each), queue depth and max queue depth (u8 each), latency sample count,
+    // min, max and average notify latency in us (u32 each).
+    ZMK_RAW_HID_CMD_GET_BLE_NOTIFY_STATS = 0x09,
+};
+
+enum zmk_raw_hid_status {
+    ZMK_RAW_HID_STATUS_OK = 0x00,
+    ZMK_RAW_HID_STATUS_UNKNOWN_COMMAND = 0x01,
+    ZMK_RAW_HID_STATUS_INVALID_ARGUMENT = 0x02,
+    ZMK_RAW_HID_STATUS_NOT_SUPPORTED = 0x03,
+    ZMK_RAW_HID_STATUS_OVERFLOW = 0x04,
+    ZMK_RAW_HID_STATUS_NOT_CONNECTED = 0x05,
+};
+
+enum zmk_raw_hid_trace_type {
+    ZMK_RAW_HID_TRACE_POSITION = 0x01,
+    ZMK_RAW_HID_TRACE_KEYCODE = 0x02,
+    ZMK_RAW_HID_TRACE_LAYER = 0x03,
+};
+
+struct bt_conn;
+
+// conn is the BLE connection the request arrived on, which gets the response, or NULL for USB.
+int zmk_raw_hid_receive(enum zmk_endpoint endpoint, struct bt_conn *conn, const uint8_t *data,
+                        size_t len);
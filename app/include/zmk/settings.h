@@ -0,0 +1,18 @@
+/*
+ * Copyright (c) 2020 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <zephyr.h>
+
+#define ZMK_SETTINGS_MAX_VALUE_SIZE 8
+
+// Settings are written back to flash in batches. Queued values are copied, so the caller's value
+// may change right after. The name has to stay valid, e.g. a string literal. A key whose value
+// ends up the same as the one last written isn't written again.
+int zmk_settings_queue_save(const char *name, const void *value, size_t len);
+// Writes all queued values now.
+void zmk_settings_flush();
@@ -26,4 +26,5 @@ static inline bool zmk_usb_is_hid_ready() { return zmk_usb_get_conn_state() == Z
 
 #ifdef CONFIG_ZMK_USB
 int zmk_usb_hid_send_report(const uint8_t *report, size_t len);
+bool zmk_usb_hid_is_boot_protocol();
 #endif /* CONFIG_ZMK_USB */
\ No newline at end of file
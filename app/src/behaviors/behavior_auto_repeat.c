@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2020 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#define DT_DRV_COMPAT zmk_behavior_auto_repeat
+
+#include <device.h>
+#include <drivers/behavior.h>
+#include <logging/log.h>
+#include <zmk/behavior.h>
+
+#include <zmk/event-manager.h>
+#include <zmk/events/keycode-state-changed.h>
+#include <zmk/hid.h>
+#include <zmk/hid_listener.h>
+
+LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
+
+#if DT_HAS_COMPAT_STATUS_OKAY(DT_DRV_COMPAT)
+
+struct behavior_auto_repeat_config {
+    uint32_t delay_ms;
+    uint32_t interval_ms;
+    uint32_t min_interval_ms;
+    uint8_t acceleration;
+};
+
+// Like host typematic, only the most recently pressed auto-repeat key repeats.
+struct active_auto_repeat {
+    bool active;
+    uint32_t position;
+    uint8_t usage_page;
+    uint32_t keycode;
+    const struct behavior_auto_repeat_config *config;
+    // timer data.
+    uint32_t interval_ms;
+    int64_t repeat_at;
+    struct k_delayed_work repeat_timer;
+};
+
+static struct active_auto_repeat active_auto_repeat = {};
+
+static int schedule_repeat(struct active_auto_repeat *repeat) {
+    // repeat_at is absolute, so the work queue latency of one tick doesn't add up over time.
+    int32_t ms_left = repeat->repeat_at - k_uptime_get();
+    return k_delayed_work_submit(&repeat->repeat_timer, K_MSEC(MAX(ms_left, 0)));
+}
+
+static void stop_repeat(struct active_auto_repeat *repeat) {
+    if (!repeat->active) {
+        return;
+    }
+    repeat->active = false;
+    k_delayed_work_cancel(&repeat->repeat_timer);
+}
+
+// Re-send a release and a press for the repeating usage only. This deliberately bypasses the
+// keycode_state_changed event so other listeners don't see a new key press for every repeat.
+static int send_repeat(struct active_auto_repeat *repeat) {
+    return zmk_hid_listener_resend_usage(repeat->usage_page, repeat->keycode);
+}
+
+static uint32_t next_interval(const struct active_auto_repeat *repeat) {
+    const struct behavior_auto_repeat_config *config = repeat->config;
+    uint32_t interval = repeat->interval_ms * (100 - config->acceleration) / 100;
+    return MAX(interval, config->min_interval_ms);
+}
+
+void behavior_auto_repeat_timer_handler(struct k_work *item) {
+    struct active_auto_repeat *repeat =
+        CONTAINER_OF(item, struct active_auto_repeat, repeat_timer);
+    if (!repeat->active) {
+        return;
+    }
+
+    LOG_DBG("repeat usage_page 0x%02X keycode 0x%02X interval %d", repeat->usage_page,
+            repeat->keycode, repeat->interval_ms);
+
+    if (send_repeat(repeat)) {
+        LOG_ERR("Unable to repeat keycode 0x%02X", repeat->keycode);
+        stop_repeat(repeat);
+        return;
+    }
+
+    repeat->repeat_at += repeat->interval_ms;
+    repeat->interval_ms = next_interval(repeat);
+    schedule_repeat(repeat);
+}
+
+static int on_auto_repeat_binding_pressed(struct zmk_behavior_binding *binding,
+                                          struct zmk_behavior_binding_event event) {
+    const struct device *dev = device_get_binding(binding->behavior_dev);
+    const struct behavior_auto_repeat_config *cfg = dev->config;
+    struct keycode_state_changed *ev =
+        keycode_state_changed_from_encoded(binding->param1, true, event.timestamp);
+    struct active_auto_repeat *repeat = &active_auto_repeat;
+
+    LOG_DBG("position %d keycode 0x%02X", event.position, binding->param1);
+
+    stop_repeat(repeat);
+    repeat->position = event.position;
+    repeat->usage_page = ev->usage_page;
+    repeat->keycode = ev->keycode;
+    repeat->config = cfg;
+    repeat->interval_ms = cfg->interval_ms;
+    repeat->repeat_at = event.timestamp + cfg->delay_ms;
+
+    int ret = ZMK_EVENT_RAISE(ev);
+
+    // Set active after raising, so the listener doesn't treat our own press as another key.
+    repeat->active = true;
+    schedule_repeat(repeat);
+    return ret;
+}
+
+static int on_auto_repeat_binding_released(struct zmk_behavior_binding *binding,
+                                           struct zmk_behavior_binding_event event) {
+    LOG_DBG("position %d keycode 0x%02X", event.position, binding->param1);
+
+    if (active_auto_repeat.position == event.position) {
+        stop_repeat(&active_auto_repeat);
+    }
+
+    return ZMK_EVENT_RAISE(
+        keycode_state_changed_from_encoded(binding->param1, false, event.timestamp));
+}
+
+static const struct behavior_driver_api behavior_auto_repeat_driver_api = {
+    .binding_pressed = on_auto_repeat_binding_pressed,
+    .binding_released = on_auto_repeat_binding_released,
+};
+
+static int auto_repeat_keycode_state_changed_listener(const struct zmk_event_header *eh) {
+    if (!is_keycode_state_changed(eh)) {
+        return 0;
+    }
+
+    struct keycode_state_changed *ev = cast_keycode_state_changed(eh);
+    struct active_auto_repeat *repeat = &active_auto_repeat;
+    if (!repeat->active || !ev->state) {
+        return 0;
+    }
+
+    // Pressing any other key stops the repeat, the same way host typematic behaves.
+    if (ev->usage_page != repeat->usage_page || ev->keycode != repeat->keycode) {
+        LOG_DBG("Another key was pressed, stop repeating 0x%02X", repeat->keycode);
+        stop_repeat(repeat);
+    }
+
+    return 0;
+}
+
+ZMK_LISTENER(behavior_auto_repeat, auto_repeat_keycode_state_changed_listener);
+ZMK_SUBSCRIPTION(behavior_auto_repeat, keycode_state_changed);
+
+static int behavior_auto_repeat_init(const struct device *dev) {
+    static bool init_first_run = true;
+    if (init_first_run) {
+        k_delayed_work_init(&active_auto_repeat.repeat_timer, behavior_auto_repeat_timer_handler);
+    }
+    init_first_run = false;
+    return 0;
+}
+
+#define KP_INST(n)                                                                                 \
+    BUILD_ASSERT(DT_INST_PROP(n, acceleration) <= 100,                                             \
+                 "Auto repeat acceleration is a percentage and can't exceed 100");                 \
+    static struct behavior_auto_repeat_config behavior_auto_repeat_config_##n = {                  \
+        .delay_ms = DT_INST_PROP(n, delay_ms),                                                     \
+        .interval_ms = DT_INST_PROP(n, interval_ms),                                               \
+        .min_interval_ms = DT_INST_PROP(n, min_interval_ms),                                       \
+        .acceleration = DT_INST_PROP(n, acceleration),                                             \
+    };                                                                                             \
+    DEVICE_AND_API_INIT(behavior_auto_repeat_##n, DT_INST_LABEL(n), behavior_auto_repeat_init,     \
+                        NULL, &behavior_auto_repeat_config_##n, APPLICATION,                       \
+                        CONFIG_KERNEL_INIT_PRIORITY_DEFAULT, &behavior_auto_repeat_driver_api);
+
+DT_INST_FOREACH_STATUS_OKAY(KP_INST)
+
+#endif
@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2020 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#define DT_DRV_COMPAT zmk_behavior_caps_word
+
+#include <device.h>
+#include <drivers/behavior.h>
+#include <logging/log.h>
+#include <zmk/behavior.h>
+
+#include <zmk/event-manager.h>
+#include <zmk/events/keycode-state-changed.h>
+#include <zmk/hid.h>
+
+LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
+
+#if DT_HAS_COMPAT_STATUS_OKAY(DT_DRV_COMPAT)
+
+// One bit per keyboard page usage 0x00-0xFF.
+#define CAPS_WORD_BITMAP_WORDS 8
+
+#define CAPS_WORD_LOW_BITS(n) ((uint32_t)((1ULL << (n)) - 1))
+
+// Bits of the keycodes lo..hi that fall into bitmap word w.
+#define CAPS_WORD_RANGE_BITS(w, lo, hi)                                                            \
+    (((hi) < (w)*32 || (lo) > (w)*32 + 31)                                                         \
+         ? 0                                                                                       \
+         : (CAPS_WORD_LOW_BITS(MIN((hi), (w)*32 + 31) - (w)*32 + 1) &                              \
+            ~CAPS_WORD_LOW_BITS(MAX((lo), (w)*32) - (w)*32)))
+
+#define CAPS_WORD_KEY_BITS(w, keycode) CAPS_WORD_RANGE_BITS(w, keycode, keycode)
+
+// Keycodes that are shifted while caps word is active.
+#define CAPS_WORD_SHIFTED_BITS(w)                                                                  \
+    CAPS_WORD_RANGE_BITS(w, HID_USAGE_KEY_KEYBOARD_A, HID_USAGE_KEY_KEYBOARD_Z)
+
+// Keycodes that always continue the word: shifted keys, digits and modifiers.
+#define CAPS_WORD_DEFAULT_CONTINUE_BITS(w)                                                         \
+    (CAPS_WORD_SHIFTED_BITS(w) |                                                                   \
+     CAPS_WORD_RANGE_BITS(w, HID_USAGE_KEY_KEYBOARD_1_AND_EXCLAMATION,                             \
+                          HID_USAGE_KEY_KEYBOARD_0_AND_RIGHT_PARENTHESIS) |                        \
+     CAPS_WORD_RANGE_BITS(w, HID_USAGE_KEY_KEYBOARD_LEFTCONTROL, HID_USAGE_KEY_KEYBOARD_RIGHT_GUI))
+
+#define CAPS_WORD_CONTINUE_LIST_ENTRY(i, n, w)                                                     \
+    | CAPS_WORD_KEY_BITS(w, HID_USAGE_ID(DT_INST_PROP_BY_IDX(n, continue_list, i)) & 0xFF)
+
+#define CAPS_WORD_CONTINUE_WORD(n, w)                                                              \
+    (CAPS_WORD_DEFAULT_CONTINUE_BITS(w) COND_CODE_1(                                               \
+        DT_INST_NODE_HAS_PROP(n, continue_list),                                                   \
+        (UTIL_LISTIFY(DT_INST_PROP_LEN(n, continue_list), CAPS_WORD_CONTINUE_LIST_ENTRY, n, w)),   \
+        ()))
+
+struct behavior_caps_word_config {
+    uint32_t continuations[CAPS_WORD_BITMAP_WORDS];
+};
+
+static const uint32_t caps_word_shifted[CAPS_WORD_BITMAP_WORDS] = {
+    CAPS_WORD_SHIFTED_BITS(0), CAPS_WORD_SHIFTED_BITS(1), CAPS_WORD_SHIFTED_BITS(2),
+    CAPS_WORD_SHIFTED_BITS(3), CAPS_WORD_SHIFTED_BITS(4), CAPS_WORD_SHIFTED_BITS(5),
+    CAPS_WORD_SHIFTED_BITS(6), CAPS_WORD_SHIFTED_BITS(7),
+};
+
+// The config of the active caps word instance, NULL while caps word is off.
+static const struct behavior_caps_word_config *active_caps_word;
+
+static inline bool caps_word_bitmap_test(const uint32_t *bitmap, uint32_t keycode) {
+    return keycode < CAPS_WORD_BITMAP_WORDS * 32 && (bitmap[keycode >> 5] & BIT(keycode & 0x1F));
+}
+
+static void activate_caps_word(const struct behavior_caps_word_config *config) {
+    LOG_DBG("caps word activated");
+    active_caps_word = config;
+}
+
+static void deactivate_caps_word() {
+    LOG_DBG("caps word deactivated");
+    active_caps_word = NULL;
+}
+
+static int on_caps_word_binding_pressed(struct zmk_behavior_binding *binding,
+                                        struct zmk_behavior_binding_event event) {
+    const struct device *dev = device_get_binding(binding->behavior_dev);
+    if (active_caps_word != NULL) {
+        deactivate_caps_word();
+    } else {
+        activate_caps_word(dev->config);
+    }
+    return 0;
+}
+
+static int on_caps_word_binding_released(struct zmk_behavior_binding *binding,
+                                         struct zmk_behavior_binding_event event) {
+    return 0;
+}
+
+static const struct behavior_driver_api behavior_caps_word_driver_api = {
+    .binding_pressed = on_caps_word_binding_pressed,
+    .binding_released = on_caps_word_binding_released,
+};
+
+// Shift is added to the implicit modifiers of the event itself, so hid_listener applies it in
+// the same report as the key. This relies on this listener running before hid_listener, which
+// holds because behaviors are linked before it.
+static int caps_word_keycode_state_changed_listener(const struct zmk_event_header *eh) {
+    if (!is_keycode_state_changed(eh)) {
+        return 0;
+    }
+
+    struct keycode_state_changed *ev = cast_keycode_state_changed(eh);
+    if (active_caps_word == NULL || !ev->state) {
+        return 0;
+    }
+
+    if (ev->usage_page != HID_USAGE_KEY) {
+        deactivate_caps_word();
+        return 0;
+    }
+
+    if (caps_word_bitmap_test(caps_word_shifted, ev->keycode)) {
+        ev->implicit_modifiers |= MOD_LSFT;
+    } else if (!caps_word_bitmap_test(active_caps_word->continuations, ev->keycode)) {
+        deactivate_caps_word();
+    }
+
+    return 0;
+}
+
+ZMK_LISTENER(behavior_caps_word, caps_word_keycode_state_changed_listener);
+ZMK_SUBSCRIPTION(behavior_caps_word, keycode_state_changed);
+
+static int behavior_caps_word_init(const struct device *dev) { return 0; }
+
+#define KP_INST(n)                                                                                 \
+    static const struct behavior_caps_word_config behavior_caps_word_config_##n = {                \
+        .continuations =                                                                           \
+            {                                                                                      \
+                CAPS_WORD_CONTINUE_WORD(n, 0),                                                     \
+                CAPS_WORD_CONTINUE_WORD(n, 1),                                                     \
+                CAPS_WORD_CONTINUE_WORD(n, 2),                                                     \
+                CAPS_WORD_CONTINUE_WORD(n, 3),                                                     \
+                CAPS_WORD_CONTINUE_WORD(n, 4),                                                     \
+                CAPS_WORD_CONTINUE_WORD(n, 5),                                                     \
+                CAPS_WORD_CONTINUE_WORD(n, 6),                                                     \
+                CAPS_WORD_CONTINUE_WORD(n, 7),                                                     \
+            },                                                                                     \
+    };                                                                                             \
+    DEVICE_AND_API_INIT(behavior_caps_word_##n, DT_INST_LABEL(n), behavior_caps_word_init, NULL,   \
+                        &behavior_caps_word_config_##n, APPLICATION,                               \
+                        CONFIG_KERNEL_INIT_PRIORITY_DEFAULT, &behavior_caps_word_driver_api);
+
+DT_INST_FOREACH_STATUS_OKAY(KP_INST)
+
+#endif
@@ -0,0 +1,327 @@
+/*
+ * Copyright (c) 2020 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#define DT_DRV_COMPAT zmk_behavior_leader_key
+
+#include <device.h>
+#include <drivers/behavior.h>
+#include <logging/log.h>
+#include <zmk/behavior.h>
+
+#include <zmk/event-manager.h>
+#include <zmk/events/keycode-state-changed.h>
+#include <zmk/hid.h>
+
+LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
+
+#if DT_HAS_COMPAT_STATUS_OKAY(DT_DRV_COMPAT)
+
+#define ZMK_BHV_LEADER_MAX_HELD 10
+
+#define LEADER_NO_NODE UINT16_MAX
+#define LEADER_NO_SEQUENCE UINT16_MAX
+#define LEADER_NO_KEY 0
+
+struct leader_sequence {
+    const uint32_t *keys;
+    const struct zmk_behavior_binding *bindings;
+    uint8_t keys_len;
+    uint8_t bindings_len;
+    uint16_t timeout_ms;
+};
+
+// Sequences are stored as a trie in a flat array, with the root at index 0. Children of a node
+// are linked through first_child/next_sibling, so a node costs a fixed few bytes and the array
+// size is known at build time: one node per key of every sequence, plus the root.
+struct leader_trie_node {
+    uint32_t key;
+    uint16_t first_child;
+    uint16_t next_sibling;
+    uint16_t sequence;
+    // How long to wait for the next key once this node is reached.
+    uint16_t timeout_ms;
+};
+
+struct behavior_leader_key_config {
+    uint16_t timeout_ms;
+    const struct leader_sequence *sequences;
+    uint16_t sequences_len;
+    struct leader_trie_node *nodes;
+};
+
+struct active_leader {
+    // NULL while no leader sequence is being entered.
+    const struct behavior_leader_key_config *config;
+    uint16_t node;
+    uint32_t position;
+    struct k_delayed_work timeout_timer;
+};
+
+static struct active_leader active_leader = {};
+
+// Set while the bindings of a matched sequence are invoked, so their keycodes pass through.
+static bool triggering_sequence;
+
+// Keys whose press was consumed by a sequence, so their release is consumed as well.
+static uint32_t consumed_keys[ZMK_BHV_LEADER_MAX_HELD] = {};
+
+static inline uint32_t leader_key(uint8_t usage_page, uint32_t keycode) {
+    uint32_t page = usage_page ? usage_page : HID_USAGE_KEY;
+    return HID_USAGE(page, keycode);
+}
+
+static inline uint32_t leader_key_from_encoded(uint32_t encoded) {
+    uint32_t usage = STRIP_MODS(encoded);
+    return leader_key(HID_USAGE_PAGE(usage) & 0xFF, HID_USAGE_ID(usage));
+}
+
+static bool store_consumed_key(uint32_t key) {
+    for (int i = 0; i < ZMK_BHV_LEADER_MAX_HELD; i++) {
+        if (consumed_keys[i] == LEADER_NO_KEY) {
+            consumed_keys[i] = key;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool release_consumed_key(uint32_t key) {
+    for (int i = 0; i < ZMK_BHV_LEADER_MAX_HELD; i++) {
+        if (consumed_keys[i] == key) {
+            consumed_keys[i] = LEADER_NO_KEY;
+            return true;
+        }
+    }
+    return false;
+}
+
+static uint16_t find_child(const struct leader_trie_node *nodes, uint16_t parent, uint32_t key) {
+    for (uint16_t child = nodes[parent].first_child; child != LEADER_NO_NODE;
+         child = nodes[child].next_sibling) {
+        if (nodes[child].key == key) {
+            return child;
+        }
+    }
+    return LEADER_NO_NODE;
+}
+
+static void stop_leader() {
+    active_leader.config = NULL;
+    k_delayed_work_cancel(&active_leader.timeout_timer);
+}
+
+static void trigger_sequence(const struct behavior_leader_key_config *config, uint16_t sequence,
+                             uint32_t position) {
+    if (sequence == LEADER_NO_SEQUENCE) {
+        LOG_DBG("No leader sequence matched");
+        return;
+    }
+
+    LOG_DBG("Leader sequence %d matched", sequence);
+    const struct leader_sequence *seq = &config->sequences[sequence];
+    triggering_sequence = true;
+    for (int i = 0; i < seq->bindings_len; i++) {
+        struct zmk_behavior_binding binding = seq->bindings[i];
+        struct zmk_behavior_binding_event event = {
+            .position = position,
+            .timestamp = k_uptime_get(),
+        };
+        behavior_keymap_binding_pressed(&binding, event);
+        behavior_keymap_binding_released(&binding, event);
+    }
+    triggering_sequence = false;
+}
+
+void behavior_leader_key_timer_handler(struct k_work *item) {
+    if (active_leader.config == NULL) {
+        return;
+    }
+
+    const struct behavior_leader_key_config *config = active_leader.config;
+    uint16_t sequence = config->nodes[active_leader.node].sequence;
+    stop_leader();
+    trigger_sequence(config, sequence, active_leader.position);
+}
+
+static void wait_at_node(uint16_t node) {
+    active_leader.node = node;
+    k_delayed_work_submit(&active_leader.timeout_timer,
+                          K_MSEC(active_leader.config->nodes[node].timeout_ms));
+}
+
+static int on_leader_key_binding_pressed(struct zmk_behavior_binding *binding,
+                                         struct zmk_behavior_binding_event event) {
+    const struct device *dev = device_get_binding(binding->behavior_dev);
+    LOG_DBG("position %d", event.position);
+
+    stop_leader();
+    active_leader.config = dev->config;
+    active_leader.position = event.position;
+    wait_at_node(0);
+    return 0;
+}
+
+static int on_leader_key_binding_released(struct zmk_behavior_binding *binding,
+                                          struct zmk_behavior_binding_event event) {
+    return 0;
+}
+
+static const struct behavior_driver_api behavior_leader_key_driver_api = {
+    .binding_pressed = on_leader_key_binding_pressed,
+    .binding_released = on_leader_key_binding_released,
+};
+
+static int leader_keycode_state_changed_listener(const struct zmk_event_header *eh) {
+    if (!is_keycode_state_changed(eh)) {
+        return 0;
+    }
+
+    if (triggering_sequence) {
+        return 0;
+    }
+
+    struct keycode_state_changed *ev = cast_keycode_state_changed(eh);
+    uint32_t key = leader_key(ev->usage_page, ev->keycode);
+
+    if (!ev->state) {
+        return release_consumed_key(key) ? ZMK_EV_EVENT_HANDLED : 0;
+    }
+
+    const struct behavior_leader_key_config *config = active_leader.config;
+    if (config == NULL) {
+        return 0;
+    }
+
+    // Let modifiers through, so e.g. shifted keys can be used in sequences.
+    if (ev->usage_page == HID_USAGE_KEY && ev->keycode >= HID_USAGE_KEY_KEYBOARD_LEFTCONTROL &&
+        ev->keycode <= HID_USAGE_KEY_KEYBOARD_RIGHT_GUI) {
+        return 0;
+    }
+
+    uint16_t child = find_child(config->nodes, active_leader.node, key);
+    if (child == LEADER_NO_NODE) {
+        LOG_DBG("No leader sequence continues with 0x%08X", key);
+        stop_leader();
+        return 0;
+    }
+
+    if (!store_consumed_key(key)) {
+        LOG_ERR("Unable to store consumed key 0x%08X", key);
+        stop_leader();
+        return 0;
+    }
+
+    const struct leader_trie_node *node = &config->nodes[child];
+    if (node->first_child == LEADER_NO_NODE) {
+        // No longer sequence starts with this one, so there is no need to wait.
+        stop_leader();
+        trigger_sequence(config, node->sequence, active_leader.position);
+    } else {
+        wait_at_node(child);
+    }
+
+    return ZMK_EV_EVENT_HANDLED;
+}
+
+ZMK_LISTENER(behavior_leader_key, leader_keycode_state_changed_listener);
+ZMK_SUBSCRIPTION(behavior_leader_key, keycode_state_changed);
+
+static void init_trie_node(struct leader_trie_node *node, uint32_t key, uint16_t next_sibling) {
+    node->key = key;
+    node->first_child = LEADER_NO_NODE;
+    node->next_sibling = next_sibling;
+    node->sequence = LEADER_NO_SEQUENCE;
+    node->timeout_ms = 0;
+}
+
+static void build_trie(const struct behavior_leader_key_config *config) {
+    struct leader_trie_node *nodes = config->nodes;
+    uint16_t nodes_len = 1;
+
+    init_trie_node(&nodes[0], LEADER_NO_KEY, LEADER_NO_NODE);
+    for (uint16_t s = 0; s < config->sequences_len; s++) {
+        const struct leader_sequence *seq = &config->sequences[s];
+        uint16_t timeout_ms = seq->timeout_ms ? seq->timeout_ms : config->timeout_ms;
+        uint16_t node = 0;
+
+        for (int i = 0; i < seq->keys_len; i++) {
+            uint32_t key = leader_key_from_encoded(seq->keys[i]);
+            uint16_t child = find_child(nodes, node, key);
+            if (child == LEADER_NO_NODE) {
+                child = nodes_len++;
+                init_trie_node(&nodes[child], key, nodes[node].first_child);
+                nodes[node].first_child = child;
+            }
+            // Wait long enough for every sequence passing through this node.
+            nodes[node].timeout_ms = MAX(nodes[node].timeout_ms, timeout_ms);
+            node = child;
+        }
+
+        if (nodes[node].sequence != LEADER_NO_SEQUENCE) {
+            LOG_WRN("Leader sequence %d duplicates sequence %d", s, nodes[node].sequence);
+            continue;
+        }
+        nodes[node].sequence = s;
+        nodes[node].timeout_ms = MAX(nodes[node].timeout_ms, timeout_ms);
+    }
+
+    LOG_DBG("Leader trie has %d nodes for %d sequences", nodes_len, config->sequences_len);
+}
+
+static int behavior_leader_key_init(const struct device *dev) {
+    static bool init_first_run = true;
+    if (init_first_run) {
+        k_delayed_work_init(&active_leader.timeout_timer, behavior_leader_key_timer_handler);
+    }
+    init_first_run = false;
+    build_trie(dev->config);
+    return 0;
+}
+
+#define _TRANSFORM_ENTRY(idx, node)                                                                \
+    {                                                                                              \
+        .behavior_dev = DT_LABEL(DT_PHANDLE_BY_IDX(node, bindings, idx)),                          \
+        .param1 = COND_CODE_0(DT_PHA_HAS_CELL_AT_IDX(node, bindings, idx, param1), (0),            \
+                              (DT_PHA_BY_IDX(node, bindings, idx, param1))),                       \
+        .param2 = COND_CODE_0(DT_PHA_HAS_CELL_AT_IDX(node, bindings, idx, param2), (0),            \
+                              (DT_PHA_BY_IDX(node, bindings, idx, param2))),                       \
+    },
+
+#define SEQUENCE_DATA(node)                                                                        \
+    static const uint32_t _CONCAT(leader_keys_, node)[] = DT_PROP(node, sequence);                 \
+    static const struct zmk_behavior_binding _CONCAT(leader_bindings_, node)[] = {                 \
+        UTIL_LISTIFY(DT_PROP_LEN(node, bindings), _TRANSFORM_ENTRY, node)};
+
+#define SEQUENCE_ENTRY(node)                                                                       \
+    {                                                                                              \
+        .keys = _CONCAT(leader_keys_, node),                                                       \
+        .keys_len = DT_PROP_LEN(node, sequence),                                                   \
+        .bindings = _CONCAT(leader_bindings_, node),                                               \
+        .bindings_len = DT_PROP_LEN(node, bindings),                                               \
+        .timeout_ms = DT_PROP_OR(node, timeout_ms, 0),                                             \
+    },
+
+#define SEQUENCE_NODES_LEN(node) DT_PROP_LEN(node, sequence) +
+
+#define KP_INST(n)                                                                                 \
+    DT_INST_FOREACH_CHILD(n, SEQUENCE_DATA)                                                        \
+    static const struct leader_sequence behavior_leader_key_sequences_##n[] = {                    \
+        DT_INST_FOREACH_CHILD(n, SEQUENCE_ENTRY)};                                                 \
+    static struct leader_trie_node                                                                 \
+        behavior_leader_key_nodes_##n[1 + DT_INST_FOREACH_CHILD(n, SEQUENCE_NODES_LEN) 0];         \
+    static const struct behavior_leader_key_config behavior_leader_key_config_##n = {              \
+        .timeout_ms = DT_INST_PROP(n, timeout_ms),                                                 \
+        .sequences = behavior_leader_key_sequences_##n,                                            \
+        .sequences_len = ARRAY_SIZE(behavior_leader_key_sequences_##n),                            \
+        .nodes = behavior_leader_key_nodes_##n,                                                    \
+    };                                                                                             \
+    DEVICE_AND_API_INIT(behavior_leader_key_##n, DT_INST_LABEL(n), behavior_leader_key_init, NULL, \
+                        &behavior_leader_key_config_##n, APPLICATION,                              \
+                        CONFIG_KERNEL_INIT_PRIORITY_DEFAULT, &behavior_leader_key_driver_api);
+
+DT_INST_FOREACH_STATUS_OKAY(KP_INST)
+
+#endif
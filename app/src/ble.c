@@ -31,6 +31,7 @@ LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 
 #include <zmk/ble.h>
 #include <zmk/keys.h>
+#include <zmk/settings.h>
 #include <zmk/split/bluetooth/uuid.h>
 #include <zmk/event-manager.h>
 #include <zmk/events/ble-active-profile-changed.h>
@@ -51,6 +52,9 @@ enum advertising_type {
     ZMK_ADV_CONN,
 } advertising_status;
 
+// The profile directed advertising was started for.
+static uint8_t advertising_profile;
+
 #define CURR_ADV(adv) (adv << 4)
 
 #define ZMK_ADV_CONN_NAME                                                                          \
@@ -60,6 +64,10 @@ enum advertising_type {
 static struct zmk_ble_profile profiles[PROFILE_COUNT];
 static uint8_t active_profile;
 
+// Referenced connection to each profile's peer, or NULL if it isn't connected. Cached so sending a
+// report doesn't need to look up the connection by address every time.
+static struct bt_conn *profile_conns[PROFILE_COUNT];
+
 #define DEVICE_NAME CONFIG_BT_DEVICE_NAME
 #define DEVICE_NAME_LEN (sizeof(DEVICE_NAME) - 1)
 
@@ -104,6 +112,46 @@ bool zmk_ble_active_profile_is_open() {
     return !bt_addr_le_cmp(&profiles[active_profile].peer, BT_ADDR_LE_ANY);
 }
 
+static void set_profile_conn(uint8_t index, struct bt_conn *conn) {
+    if (profile_conns[index] == conn) {
+        return;
+    }
+
+    if (profile_conns[index]) {
+        bt_conn_unref(profile_conns[index]);
+    }
+
+    profile_conns[index] = conn ? bt_conn_ref(conn) : NULL;
+}
+
+// Only needed when a profile's address changes, connections and disconnections update the cache
+// directly.
+static void refresh_profile_conn(uint8_t index) {
+    struct bt_conn *conn = NULL;
+    bt_addr_le_t *addr = &profiles[index].peer;
+
+    if (bt_addr_le_cmp(addr, BT_ADDR_LE_ANY)) {
+        conn = bt_conn_lookup_addr_le(BT_ID_DEFAULT, addr);
+    }
+
+    set_profile_conn(index, conn);
+
+    if (conn) {
+        bt_conn_unref(conn);
+    }
+}
+
+static int profile_index_for_conn(const struct bt_conn *conn) {
+    for (int i = 0; i < PROFILE_COUNT; i++) {
+        if (bt_addr_le_cmp(&profiles[i].peer, BT_ADDR_LE_ANY) &&
+            !bt_addr_le_cmp(bt_conn_get_dst(conn), &profiles[i].peer)) {
+            return i;
+        }
+    }
+
+    return -ENODEV;
+}
+
 void set_profile_address(uint8_t index, const bt_addr_le_t *addr) {
     char setting_name[15];
     char addr_str[BT_ADDR_LE_STR_LEN];
@@ -114,22 +162,43 @@ void set_profile_address(uint8_t index, const bt_addr_le_t *addr) {
     sprintf(setting_name, "ble/profiles/%d", index);
     LOG_DBG("Setting profile addr for %s to %s", log_strdup(setting_name), log_strdup(addr_str));
     settings_save_one(setting_name, &profiles[index], sizeof(struct zmk_ble_profile));
+    refresh_profile_conn(index);
     k_work_submit(&raise_profile_changed_event_work);
 }
 
-bool zmk_ble_active_profile_is_connected() {
-    struct bt_conn *conn;
-    bt_addr_le_t *addr = zmk_ble_active_profile_addr();
-    if (!bt_addr_le_cmp(addr, BT_ADDR_LE_ANY)) {
-        return false;
-    } else if ((conn = bt_conn_lookup_addr_le(BT_ID_DEFAULT, addr)) == NULL) {
-        return false;
+bool zmk_ble_active_profile_is_connected() { return profile_conns[active_profile] != NULL; }
+
+struct bt_conn *zmk_ble_active_profile_conn() { return profile_conns[active_profile]; }
+
+struct bt_conn *zmk_ble_profile_conn(uint8_t index) {
+    return index < PROFILE_COUNT ? profile_conns[index] : NULL;
+}
+
+int zmk_ble_profile_count() { return PROFILE_COUNT; }
+
+int zmk_ble_connected_profile_count() {
+    int count = 0;
+    for (int i = 0; i < PROFILE_COUNT; i++) {
+        if (profile_conns[i] != NULL) {
+            count++;
+        }
     }
 
-    bt_conn_unref(conn);
+    return count;
+}
+
+#if IS_ENABLED(CONFIG_ZMK_BLE_MULTI_CONN)
+// Whether another bonded host may still connect, so advertising has to continue.
+static bool profiles_waiting_for_connection() {
+    for (int i = 0; i < PROFILE_COUNT; i++) {
+        if (bt_addr_le_cmp(&profiles[i].peer, BT_ADDR_LE_ANY) && profile_conns[i] == NULL) {
+            return true;
+        }
+    }
 
-    return true;
+    return false;
 }
+#endif /* IS_ENABLED(CONFIG_ZMK_BLE_MULTI_CONN) */
 
 #define CHECKED_ADV_STOP()                                                                         \
     err = bt_le_adv_stop();                                                                        \
@@ -139,21 +208,26 @@ bool zmk_ble_active_profile_is_connected() {
         return err;                                                                                \
     }
 
+#if IS_ENABLED(CONFIG_ZMK_BLE_FAST_RECONNECT_RPA)
+#define ZMK_ADV_DIR_OPTIONS BT_LE_ADV_OPT_DIR_ADDR_RPA
+#else
+#define ZMK_ADV_DIR_OPTIONS 0
+#endif
+
+// High duty cycle directed advertising, which the controller stops on its own after 1.28s.
+#define ZMK_ADV_CONN_DIR(addr)                                                                     \
+    BT_LE_ADV_PARAM(BT_LE_ADV_OPT_CONNECTABLE | BT_LE_ADV_OPT_ONE_TIME | ZMK_ADV_DIR_OPTIONS, 0,   \
+                    0, addr)
+
 #define CHECKED_DIR_ADV()                                                                          \
     addr = zmk_ble_active_profile_addr();                                                          \
-    conn = bt_conn_lookup_addr_le(BT_ID_DEFAULT, addr);                                            \
-    if (conn != NULL) { /* TODO: Check status of connection */                                     \
-        LOG_DBG("Skipping advertising, profile host is already connected");                        \
-        bt_conn_unref(conn);                                                                       \
-        return 0;                                                                                  \
-    }                                                                                              \
-    err = bt_le_adv_start(BT_LE_ADV_CONN_DIR_LOW_DUTY(addr), zmk_ble_ad, ARRAY_SIZE(zmk_ble_ad),   \
-                          NULL, 0);                                                                \
+    err = bt_le_adv_start(ZMK_ADV_CONN_DIR(addr), zmk_ble_ad, ARRAY_SIZE(zmk_ble_ad), NULL, 0);    \
     if (err) {                                                                                     \
         LOG_ERR("Advertising failed to start (err %d)", err);                                      \
         return err;                                                                                \
     }                                                                                              \
-    advertising_status = ZMK_ADV_DIR;
+    advertising_status = ZMK_ADV_DIR;                                                              \
+    advertising_profile = active_profile;
 
 #define CHECKED_OPEN_ADV()                                                                         \
     err = bt_le_adv_start(ZMK_ADV_CONN_NAME, zmk_ble_ad, ARRAY_SIZE(zmk_ble_ad), NULL, 0);         \
@@ -163,24 +237,63 @@ bool zmk_ble_active_profile_is_connected() {
     }                                                                                              \
     advertising_status = ZMK_ADV_CONN;
 
+int update_advertising();
+
+#if IS_ENABLED(CONFIG_ZMK_BLE_FAST_RECONNECT)
+// While the window is open, the bonded host of the active profile is advertised to directly,
+// which is how it reconnects the fastest. Afterwards any host may connect again.
+static int64_t fast_reconnect_until;
+
+static void fast_reconnect_timeout(struct k_work *work) { update_advertising(); }
+
+static struct k_delayed_work fast_reconnect_work;
+
+static void start_fast_reconnect() {
+    fast_reconnect_until = k_uptime_get() + CONFIG_ZMK_BLE_FAST_RECONNECT_WINDOW;
+    k_delayed_work_submit(&fast_reconnect_work, K_MSEC(CONFIG_ZMK_BLE_FAST_RECONNECT_WINDOW));
+}
+
+static bool is_fast_reconnecting() { return k_uptime_get() < fast_reconnect_until; }
+
+// Hosts using privacy ignore directed advertising to their identity address, so unless it is
+// directed at their resolvable private address, a round that times out ends the window early.
+static void directed_advertising_timed_out() {
+    if (IS_ENABLED(CONFIG_ZMK_BLE_FAST_RECONNECT_RPA)) {
+        return;
+    }
+
+    fast_reconnect_until = 0;
+    k_delayed_work_cancel(&fast_reconnect_work);
+}
+#else
+static inline void start_fast_reconnect() {}
+static inline void directed_advertising_timed_out() {}
+static inline bool is_fast_reconnecting() { return false; }
+#endif /* IS_ENABLED(CONFIG_ZMK_BLE_FAST_RECONNECT) */
+
 int update_advertising() {
     int err = 0;
     bt_addr_le_t *addr;
-    struct bt_conn *conn;
     enum advertising_type desired_adv = ZMK_ADV_NONE;
 
     if (zmk_ble_active_profile_is_open()) {
         desired_adv = ZMK_ADV_CONN;
     } else if (!zmk_ble_active_profile_is_connected()) {
+        desired_adv = is_fast_reconnecting() ? ZMK_ADV_DIR : ZMK_ADV_CONN;
+    }
+
+#if IS_ENABLED(CONFIG_ZMK_BLE_MULTI_CONN)
+    // Keep advertising until the hosts of all the other bonded profiles are connected as well.
+    if (desired_adv == ZMK_ADV_NONE && profiles_waiting_for_connection()) {
         desired_adv = ZMK_ADV_CONN;
-        // Need to fix directed advertising for privacy centrals. See
-        // https://github.com/zephyrproject-rtos/zephyr/pull/14984 char
-        // addr_str[BT_ADDR_LE_STR_LEN]; bt_addr_le_to_str(zmk_ble_active_profile_addr(), addr_str,
-        // sizeof(addr_str));
+    }
+#endif /* IS_ENABLED(CONFIG_ZMK_BLE_MULTI_CONN) */
 
-        // LOG_DBG("Directed advertising to %s", log_strdup(addr_str));
-        // desired_adv = ZMK_ADV_DIR;
+    if (desired_adv == advertising_status &&
+        (desired_adv != ZMK_ADV_DIR || advertising_profile == active_profile)) {
+        return 0;
     }
+
     LOG_DBG("advertising from %d to %d", advertising_status, desired_adv);
 
     switch (desired_adv + CURR_ADV(advertising_status)) {
@@ -228,18 +341,9 @@ int zmk_ble_clear_bonds() {
 
 int zmk_ble_active_profile_index() { return active_profile; }
 
-#if IS_ENABLED(CONFIG_SETTINGS)
-static void ble_save_profile_work(struct k_work *work) {
-    settings_save_one("ble/active_profile", &active_profile, sizeof(active_profile));
-}
-
-static struct k_delayed_work ble_save_work;
-#endif
-
 static int ble_save_profile() {
 #if IS_ENABLED(CONFIG_SETTINGS)
-    k_delayed_work_cancel(&ble_save_work);
-    return k_delayed_work_submit(&ble_save_work, K_MSEC(CONFIG_ZMK_SETTINGS_SAVE_DEBOUNCE));
+    return zmk_settings_queue_save("ble/active_profile", &active_profile, sizeof(active_profile));
 #else
     return 0;
 #endif
@@ -254,6 +358,10 @@ int zmk_ble_prof_select(uint8_t index) {
     active_profile = index;
     ble_save_profile();
 
+    if (!zmk_ble_active_profile_is_open() && !zmk_ble_active_profile_is_connected()) {
+        start_fast_reconnect();
+    }
+
     update_advertising();
 
     raise_profile_changed_event();
@@ -363,7 +471,13 @@ static void connected(struct bt_conn *conn, uint8_t err) {
 
     advertising_status = ZMK_ADV_NONE;
 
-    if (err) {
+    if (err == BT_HCI_ERR_ADV_TIMEOUT) {
+        // Directed advertising ended without the host connecting, start the next round.
+        LOG_DBG("Directed advertising timed out");
+        directed_advertising_timed_out();
+        update_advertising();
+        return;
+    } else if (err) {
         LOG_WRN("Failed to connect to %s (%u)", log_strdup(addr), err);
         update_advertising();
         return;
@@ -371,9 +485,11 @@ static void connected(struct bt_conn *conn, uint8_t err) {
 
     LOG_DBG("Connected %s", log_strdup(addr));
 
+#if !IS_ENABLED(CONFIG_ZMK_BLE_CONN_PARAMS)
     bt_conn_le_param_update(conn, BT_LE_CONN_PARAM(0x0006, 0x000c, 30, 400));
+#endif
 
-#if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_ROLE_PERIPHERAL)
+#if IS_ENABLED(CONFIG_ZMK_SPLIT_BLE_ROLE_PERIPHERAL) && !IS_ENABLED(CONFIG_ZMK_BLE_PHY_2M)
     bt_conn_le_phy_update(conn, BT_CONN_LE_PHY_PARAM_2M);
 #endif
 
@@ -381,6 +497,11 @@ static void connected(struct bt_conn *conn, uint8_t err) {
         LOG_ERR("Failed to set security");
     }
 
+    int profile = profile_index_for_conn(conn);
+    if (profile >= 0) {
+        set_profile_conn(profile, conn);
+    }
+
     update_advertising();
 
     if (is_conn_active_profile(conn)) {
@@ -396,12 +517,19 @@ static void disconnected(struct bt_conn *conn, uint8_t reason) {
 
     LOG_DBG("Disconnected from %s (reason 0x%02x)", log_strdup(addr), reason);
 
+    for (int i = 0; i < PROFILE_COUNT; i++) {
+        if (profile_conns[i] == conn) {
+            set_profile_conn(i, NULL);
+        }
+    }
+
     // We need to do this in a work callback, otherwise the advertising update will still see the
     // connection for a profile as active, and not start advertising yet.
     k_work_submit(&update_advertising_work);
 
     if (is_conn_active_profile(conn)) {
         LOG_DBG("Active profile disconnected");
+        start_fast_reconnect();
         k_work_submit(&raise_profile_changed_event_work);
     }
 }
@@ -523,6 +651,11 @@ static void zmk_ble_ready(int err) {
         return;
     }
 
+    // After waking from sleep, get the host of the active profile back as fast as possible.
+    if (!zmk_ble_active_profile_is_open()) {
+        start_fast_reconnect();
+    }
+
     update_advertising();
 }
 
@@ -543,8 +676,6 @@ static int zmk_ble_init(const struct device *_arg) {
         return err;
     }
 
-    k_delayed_work_init(&ble_save_work, ble_save_profile_work);
-
     settings_load_subtree("ble");
     settings_load_subtree("bt");
 
@@ -568,6 +699,10 @@ static int zmk_ble_init(const struct device *_arg) {
     }
 #endif
 
+#if IS_ENABLED(CONFIG_ZMK_BLE_FAST_RECONNECT)
+    k_delayed_work_init(&fast_reconnect_work, fast_reconnect_timeout);
+#endif
+
     bt_conn_cb_register(&conn_callbacks);
     bt_conn_auth_cb_register(&zmk_ble_auth_cb_display);
 
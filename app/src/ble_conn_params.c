@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) 2020 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <device.h>
+#include <init.h>
+#include <kernel.h>
+
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/conn.h>
+
+#include <logging/log.h>
+
+LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
+
+#include <zmk/activity.h>
+#include <zmk/ble.h>
+#include <zmk/event-manager.h>
+#include <zmk/events/activity-state-changed.h>
+#include <zmk/events/ble-active-profile-changed.h>
+
+// Connections to hosts use short intervals and no slave latency while the keyboard is in use, and
+// longer intervals with slave latency while it is idle. Hosts are free to reject or ignore a
+// request, so the parameters are checked after each request and requested again with a growing
+// delay until the host accepts them or we run out of attempts. With ZMK_BLE_MULTI_CONN, the
+// connections to the hosts of profiles other than the active one always use the idle parameters.
+
+static const struct bt_le_conn_param active_params = BT_LE_CONN_PARAM_INIT(
+    CONFIG_ZMK_BLE_ACTIVE_CONN_INTERVAL_MIN, CONFIG_ZMK_BLE_ACTIVE_CONN_INTERVAL_MAX,
+    CONFIG_ZMK_BLE_ACTIVE_CONN_LATENCY, CONFIG_ZMK_BLE_ACTIVE_CONN_TIMEOUT);
+
+static const struct bt_le_conn_param idle_params = BT_LE_CONN_PARAM_INIT(
+    CONFIG_ZMK_BLE_IDLE_CONN_INTERVAL_MIN, CONFIG_ZMK_BLE_IDLE_CONN_INTERVAL_MAX,
+    CONFIG_ZMK_BLE_IDLE_CONN_LATENCY, CONFIG_ZMK_BLE_IDLE_CONN_TIMEOUT);
+
+struct conn_params_state {
+    struct bt_conn *conn;
+    uint8_t attempts;
+    uint32_t retry_ms;
+    struct k_delayed_work check_work;
+};
+
+static struct conn_params_state states[CONFIG_BT_MAX_CONN];
+
+static bool is_idle(struct bt_conn *conn) {
+    if (IS_ENABLED(CONFIG_ZMK_BLE_MULTI_CONN) && conn != zmk_ble_active_profile_conn()) {
+        return true;
+    }
+
+    return zmk_activity_get_state() != ZMK_ACTIVITY_ACTIVE;
+}
+
+static const struct bt_le_conn_param *desired_params(struct bt_conn *conn) {
+    return is_idle(conn) ? &idle_params : &active_params;
+}
+
+static bool params_match(const struct bt_le_conn_param *param, uint16_t interval,
+                         uint16_t latency) {
+    return interval >= param->interval_min && interval <= param->interval_max &&
+           latency == param->latency;
+}
+
+static void request_params(struct conn_params_state *state) {
+    const struct bt_le_conn_param *param = desired_params(state->conn);
+
+    int err = bt_conn_le_param_update(state->conn, param);
+    if (err == -EALREADY) {
+        LOG_DBG("Connection already uses the %s parameters",
+                is_idle(state->conn) ? "idle" : "active");
+        return;
+    } else if (err) {
+        LOG_WRN("Failed to request connection parameters (err %d)", err);
+    }
+
+    state->attempts++;
+    k_delayed_work_submit(&state->check_work, K_MSEC(state->retry_ms));
+}
+
+static void restart_requests(struct conn_params_state *state) {
+    k_delayed_work_cancel(&state->check_work);
+    state->attempts = 0;
+    state->retry_ms = CONFIG_ZMK_BLE_CONN_PARAMS_RETRY_MS;
+    request_params(state);
+}
+
+static void check_params_work(struct k_work *work) {
+    struct conn_params_state *state = CONTAINER_OF(work, struct conn_params_state, check_work);
+    struct bt_conn_info info;
+
+    if (state->conn == NULL || bt_conn_get_info(state->conn, &info)) {
+        return;
+    }
+
+    if (params_match(desired_params(state->conn), info.le.interval, info.le.latency)) {
+        return;
+    }
+
+    if (state->attempts >= CONFIG_ZMK_BLE_CONN_PARAMS_MAX_ATTEMPTS) {
+        LOG_WRN("Host kept interval %d latency %d, giving up until the activity state changes",
+                info.le.interval, info.le.latency);
+        return;
+    }
+
+    state->retry_ms = MIN(state->retry_ms * 2, CONFIG_ZMK_BLE_CONN_PARAMS_RETRY_MAX_MS);
+    LOG_DBG("Host kept interval %d latency %d, requesting again (attempt %d)", info.le.interval,
+            info.le.latency, state->attempts + 1);
+    request_params(state);
+}
+
+static struct conn_params_state *find_state(struct bt_conn *conn) {
+    for (int i = 0; i < ARRAY_SIZE(states); i++) {
+        if (states[i].conn == conn) {
+            return &states[i];
+        }
+    }
+
+    return NULL;
+}
+
+static void conn_params_connected(struct bt_conn *conn, uint8_t err) {
+    struct bt_conn_info info;
+
+    if (err || bt_conn_get_info(conn, &info) || info.role != BT_CONN_ROLE_SLAVE) {
+        return;
+    }
+
+    struct conn_params_state *state = find_state(NULL);
+    if (state == NULL) {
+        LOG_ERR("No free connection parameter state");
+        return;
+    }
+
+    state->conn = bt_conn_ref(conn);
+    restart_requests(state);
+}
+
+static void conn_params_disconnected(struct bt_conn *conn, uint8_t reason) {
+    struct conn_params_state *state = find_state(conn);
+    if (state == NULL) {
+        return;
+    }
+
+    k_delayed_work_cancel(&state->check_work);
+    bt_conn_unref(state->conn);
+    state->conn = NULL;
+}
+
+static void conn_params_updated(struct bt_conn *conn, uint16_t interval, uint16_t latency,
+                                uint16_t timeout) {
+    struct conn_params_state *state = find_state(conn);
+    if (state == NULL) {
+        return;
+    }
+
+    LOG_DBG("Connection parameters updated: interval %d latency %d timeout %d", interval, latency,
+            timeout);
+
+    if (params_match(desired_params(conn), interval, latency)) {
+        k_delayed_work_cancel(&state->check_work);
+    }
+}
+
+static struct bt_conn_cb conn_callbacks = {
+    .connected = conn_params_connected,
+    .disconnected = conn_params_disconnected,
+    .le_param_updated = conn_params_updated,
+};
+
+static int conn_params_listener(const struct zmk_event_header *eh) {
+    // The keyboard powers off when it goes to sleep, so there's nothing left to save there.
+    if (is_activity_state_changed(eh) &&
+        cast_activity_state_changed(eh)->state == ZMK_ACTIVITY_SLEEP) {
+        return 0;
+    }
+
+    for (int i = 0; i < ARRAY_SIZE(states); i++) {
+        if (states[i].conn != NULL) {
+            restart_requests(&states[i]);
+        }
+    }
+
+    return 0;
+}
+
+ZMK_LISTENER(ble_conn_params, conn_params_listener);
+ZMK_SUBSCRIPTION(ble_conn_params, activity_state_changed);
+#if IS_ENABLED(CONFIG_ZMK_BLE_MULTI_CONN)
+ZMK_SUBSCRIPTION(ble_conn_params, ble_active_profile_changed);
+#endif /* IS_ENABLED(CONFIG_ZMK_BLE_MULTI_CONN) */
+
+static int conn_params_init(const struct device *_arg) {
+    for (int i = 0; i < ARRAY_SIZE(states); i++) {
+        k_delayed_work_init(&states[i].check_work, check_params_work);
+    }
+
+    bt_conn_cb_register(&conn_callbacks);
+
+    return 0;
+}
+
+SYS_INIT(conn_params_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
@@ -0,0 +1,196 @@
+/*
+ * Copyright (c) 2020 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <device.h>
+#include <init.h>
+#include <kernel.h>
+
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/conn.h>
+
+#include <logging/log.h>
+
+LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
+
+#include <zmk/ble/link.h>
+
+// Negotiates the PHY and data length of host connections and keeps track of the resulting link
+// state. The 2M PHY halves the airtime of every report, and longer link layer packets let larger
+// reports like raw HID frames go out in a single packet. Hosts or controllers that don't support
+// either simply keep the defaults, which is logged but not retried.
+
+// Transmit time of the largest packet on the 1M PHY, which also covers the 2M PHY.
+#define DATA_LEN_TIME(octets) (((octets) + 14) * 8)
+
+struct link_state {
+    struct bt_conn *conn;
+    struct zmk_ble_link_stats stats;
+};
+
+static struct link_state links[CONFIG_BT_MAX_CONN];
+
+static struct link_state *find_link(const struct bt_conn *conn) {
+    for (int i = 0; i < ARRAY_SIZE(links); i++) {
+        if (links[i].conn == conn) {
+            return &links[i];
+        }
+    }
+
+    return NULL;
+}
+
+int zmk_ble_link_get_stats(struct bt_conn *conn, struct zmk_ble_link_stats *stats) {
+    struct link_state *link = find_link(conn);
+    if (conn == NULL || link == NULL) {
+        return -ENOTCONN;
+    }
+
+    *stats = link->stats;
+    return 0;
+}
+
+static void request_link_upgrades(struct bt_conn *conn) {
+    int err;
+
+#if IS_ENABLED(CONFIG_ZMK_BLE_PHY_2M)
+    err = bt_conn_le_phy_update(conn, BT_CONN_LE_PHY_PARAM_2M);
+    if (err) {
+        LOG_WRN("Failed to request the 2M PHY (err %d)", err);
+    }
+#endif /* IS_ENABLED(CONFIG_ZMK_BLE_PHY_2M) */
+
+#if IS_ENABLED(CONFIG_ZMK_BLE_DATA_LEN_EXT)
+    const struct bt_conn_le_data_len_param data_len = {
+        .tx_max_len = CONFIG_ZMK_BLE_DATA_LEN_TX_OCTETS,
+        .tx_max_time = DATA_LEN_TIME(CONFIG_ZMK_BLE_DATA_LEN_TX_OCTETS),
+    };
+    err = bt_conn_le_data_len_update(conn, &data_len);
+    if (err) {
+        LOG_WRN("Failed to request a data length of %d (err %d)", data_len.tx_max_len, err);
+    }
+#endif /* IS_ENABLED(CONFIG_ZMK_BLE_DATA_LEN_EXT) */
+}
+
+static void link_connected(struct bt_conn *conn, uint8_t err) {
+    struct bt_conn_info info;
+
+    if (err || bt_conn_get_info(conn, &info) || info.role != BT_CONN_ROLE_SLAVE) {
+        return;
+    }
+
+    struct link_state *link = find_link(NULL);
+    if (link == NULL) {
+        LOG_ERR("No free link state");
+        return;
+    }
+
+    link->conn = bt_conn_ref(conn);
+    link->stats = (struct zmk_ble_link_stats){
+        .interval = info.le.interval,
+        .latency = info.le.latency,
+        .timeout = info.le.timeout,
+        .tx_phy = BT_GAP_LE_PHY_1M,
+        .rx_phy = BT_GAP_LE_PHY_1M,
+        .tx_max_len = 27,
+        .rx_max_len = 27,
+    };
+
+#if IS_ENABLED(CONFIG_BT_USER_PHY_UPDATE)
+    link->stats.tx_phy = info.le.phy->tx_phy;
+    link->stats.rx_phy = info.le.phy->rx_phy;
+#endif /* IS_ENABLED(CONFIG_BT_USER_PHY_UPDATE) */
+
+#if IS_ENABLED(CONFIG_BT_USER_DATA_LEN_UPDATE)
+    link->stats.tx_max_len = info.le.data_len->tx_max_len;
+    link->stats.rx_max_len = info.le.data_len->rx_max_len;
+#endif /* IS_ENABLED(CONFIG_BT_USER_DATA_LEN_UPDATE) */
+
+    request_link_upgrades(conn);
+}
+
+static void link_disconnected(struct bt_conn *conn, uint8_t reason) {
+    struct link_state *link = find_link(conn);
+    if (link == NULL) {
+        return;
+    }
+
+    bt_conn_unref(link->conn);
+    link->conn = NULL;
+}
+
+static void link_param_updated(struct bt_conn *conn, uint16_t interval, uint16_t latency,
+                               uint16_t timeout) {
+    struct link_state *link = find_link(conn);
+    if (link == NULL) {
+        return;
+    }
+
+    link->stats.interval = interval;
+    link->stats.latency = latency;
+    link->stats.timeout = timeout;
+    link->stats.param_updates++;
+}
+
+#if IS_ENABLED(CONFIG_BT_USER_PHY_UPDATE)
+static const char *phy_name(uint8_t phy) {
+    switch (phy) {
+    case BT_GAP_LE_PHY_1M:
+        return "1M";
+    case BT_GAP_LE_PHY_2M:
+        return "2M";
+    case BT_GAP_LE_PHY_CODED:
+        return "coded";
+    default:
+        return "unknown";
+    }
+}
+
+static void link_phy_updated(struct bt_conn *conn, struct bt_conn_le_phy_info *info) {
+    struct link_state *link = find_link(conn);
+    if (link == NULL) {
+        return;
+    }
+
+    LOG_INF("Link PHY tx %s rx %s", phy_name(info->tx_phy), phy_name(info->rx_phy));
+
+    link->stats.tx_phy = info->tx_phy;
+    link->stats.rx_phy = info->rx_phy;
+    link->stats.phy_updates++;
+}
+#endif /* IS_ENABLED(CONFIG_BT_USER_PHY_UPDATE) */
+
+#if IS_ENABLED(CONFIG_BT_USER_DATA_LEN_UPDATE)
+static void link_data_len_updated(struct bt_conn *conn, struct bt_conn_le_data_len_info *info) {
+    struct link_state *link = find_link(conn);
+    if (link == NULL) {
+        return;
+    }
+
+    LOG_INF("Link data length tx %d rx %d", info->tx_max_len, info->rx_max_len);
+
+    link->stats.tx_max_len = info->tx_max_len;
+    link->stats.rx_max_len = info->rx_max_len;
+}
+#endif /* IS_ENABLED(CONFIG_BT_USER_DATA_LEN_UPDATE) */
+
+static struct bt_conn_cb conn_callbacks = {
+    .connected = link_connected,
+    .disconnected = link_disconnected,
+    .le_param_updated = link_param_updated,
+#if IS_ENABLED(CONFIG_BT_USER_PHY_UPDATE)
+    .le_phy_updated = link_phy_updated,
+#endif /* IS_ENABLED(CONFIG_BT_USER_PHY_UPDATE) */
+#if IS_ENABLED(CONFIG_BT_USER_DATA_LEN_UPDATE)
+    .le_data_len_updated = link_data_len_updated,
+#endif /* IS_ENABLED(CONFIG_BT_USER_DATA_LEN_UPDATE) */
+};
+
+static int link_init(const struct device *_arg) {
+    bt_conn_cb_register(&conn_callbacks);
+    return 0;
+}
+
+SYS_INIT(link_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2020 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <kernel.h>
+#include <shell/shell.h>
+
+#include <bluetooth/conn.h>
+
+#include <zmk/ble.h>
+#include <zmk/ble/link.h>
+#include <zmk/hog.h>
+
+static int cmd_ble_stats(const struct shell *shell, size_t argc, char **argv) {
+    int shown = 0;
+
+    for (int i = 0; i < zmk_ble_profile_count(); i++) {
+        struct bt_conn *conn = zmk_ble_profile_conn(i);
+        struct zmk_ble_link_stats link;
+        struct zmk_hog_stats hog;
+
+        if (conn == NULL || zmk_ble_link_get_stats(conn, &link) || zmk_hog_get_stats(conn, &hog)) {
+            continue;
+        }
+
+        shell_print(shell, "Profile %d%s", i,
+                    i == zmk_ble_active_profile_index() ? " (active)" : "");
+        // The interval is in units of 1.25 ms and the timeout in units of 10 ms.
+        shell_print(shell, "  interval %d.%02d ms, latency %d, timeout %d ms, %d updates",
+                    link.interval * 125 / 100, link.interval * 125 % 100, link.latency,
+                    link.timeout * 10, link.param_updates);
+        shell_print(shell, "  PHY tx %d rx %d, %d updates, data length tx %d rx %d", link.tx_phy,
+                    link.rx_phy, link.phy_updates, link.tx_max_len, link.rx_max_len);
+        shell_print(shell, "  notifications %u sent, %u failed, queue %u (max %u)", hog.notify_sent,
+                    hog.notify_failed, hog.queue_depth, hog.max_queue_depth);
+        if (hog.latency_count > 0) {
+            shell_print(shell, "  notify latency min %u us, avg %u us, max %u us",
+                        hog.latency_min_us, (uint32_t)(hog.latency_total_us / hog.latency_count),
+                        hog.latency_max_us);
+        }
+        shown++;
+    }
+
+    if (shown == 0) {
+        shell_print(shell, "No host connected");
+    }
+
+    return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_zmk_ble,
+                               SHELL_CMD(stats, NULL, "Show statistics of the host connections",
+                                         cmd_ble_stats),
+                               SHELL_SUBCMD_SET_END);
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_zmk, SHELL_CMD(ble, &sub_zmk_ble, "Bluetooth commands", NULL),
+                               SHELL_SUBCMD_SET_END);
+
+SHELL_CMD_REGISTER(zmk, &sub_zmk, "ZMK commands", NULL);
@@ -10,9 +10,11 @@
 #include <zmk/ble.h>
 #include <zmk/endpoints.h>
 #include <zmk/hid.h>
+#include <zmk/hid_indicators.h>
 #include <dt-bindings/zmk/hid_usage_pages.h>
 #include <zmk/usb.h>
 #include <zmk/hog.h>
+#include <zmk/settings.h>
 #include <zmk/event-manager.h>
 #include <zmk/events/ble-active-profile-changed.h>
 #include <zmk/events/usb-conn-state-changed.h>
@@ -26,21 +28,19 @@ LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 static enum zmk_endpoint current_endpoint = DEFAULT_ENDPOINT;
 static enum zmk_endpoint preferred_endpoint =
     ZMK_ENDPOINT_USB; /* Used if multiple endpoints are ready */
+/* Send reports to all ready endpoints instead of only the current one. */
+static bool broadcast = false;
 
 static void update_current_endpoint();
 
-#if IS_ENABLED(CONFIG_SETTINGS)
-static void endpoints_save_preferred_work(struct k_work *work) {
-    settings_save_one("endpoints/preferred", &preferred_endpoint, sizeof(preferred_endpoint));
-}
-
-static struct k_delayed_work endpoints_save_work;
-#endif
-
 static int endpoints_save_preferred() {
 #if IS_ENABLED(CONFIG_SETTINGS)
-    k_delayed_work_cancel(&endpoints_save_work);
-    return k_delayed_work_submit(&endpoints_save_work, K_MSEC(CONFIG_ZMK_SETTINGS_SAVE_DEBOUNCE));
+    int err = zmk_settings_queue_save("endpoints/preferred", &preferred_endpoint,
+                                      sizeof(preferred_endpoint));
+    if (err) {
+        return err;
+    }
+    return zmk_settings_queue_save("endpoints/broadcast", &broadcast, sizeof(broadcast));
 #else
     return 0;
 #endif
@@ -49,6 +49,9 @@ static int endpoints_save_preferred() {
 int zmk_endpoints_select(enum zmk_endpoint endpoint) {
     LOG_DBG("Selected endpoint %d", endpoint);
 
+    // Selecting a single endpoint ends broadcasting.
+    zmk_endpoints_set_broadcast(false);
+
     if (preferred_endpoint == endpoint) {
         return 0;
     }
@@ -70,13 +73,59 @@ int zmk_endpoints_toggle() {
     return zmk_endpoints_select(new_endpoint);
 }
 
-static int send_keyboard_report() {
+static void disconnect_current_endpoint();
+
+int zmk_endpoints_set_broadcast(bool enable) {
+    if (broadcast == enable) {
+        return 0;
+    }
+
+    LOG_DBG("Broadcast %s", enable ? "enabled" : "disabled");
+
+    // Release all keys on the endpoints that currently receive the reports.
+    disconnect_current_endpoint();
+
+    broadcast = enable;
+    endpoints_save_preferred();
+
+#if IS_ENABLED(CONFIG_ZMK_BLE)
+    zmk_hog_set_broadcast(enable);
+#endif /* IS_ENABLED(CONFIG_ZMK_BLE) */
+
+    zmk_hid_reports_invalidate();
+    return 0;
+}
+
+bool zmk_endpoints_is_broadcast() { return broadcast; }
+
+// Hosts in the boot protocol, like a BIOS or KVM, only understand the boot keyboard report.
+static bool endpoint_is_boot_protocol(enum zmk_endpoint endpoint) {
+    switch (endpoint) {
+#if IS_ENABLED(CONFIG_ZMK_USB)
+    case ZMK_ENDPOINT_USB:
+        return zmk_usb_hid_is_boot_protocol();
+#endif /* IS_ENABLED(CONFIG_ZMK_USB) */
+
+    // HOG picks the report for the protocol of each host itself.
+    default:
+        return false;
+    }
+}
+
+static int send_keyboard_report_to_endpoint(enum zmk_endpoint endpoint) {
     struct zmk_hid_keyboard_report *keyboard_report = zmk_hid_get_keyboard_report();
+    bool boot_protocol = endpoint_is_boot_protocol(endpoint);
 
-    switch (current_endpoint) {
+    switch (endpoint) {
 #if IS_ENABLED(CONFIG_ZMK_USB)
     case ZMK_ENDPOINT_USB: {
-        int err = zmk_usb_hid_send_report((uint8_t *)keyboard_report, sizeof(*keyboard_report));
+        int err;
+        if (boot_protocol) {
+            struct zmk_hid_boot_report *boot_report = zmk_hid_get_boot_report();
+            err = zmk_usb_hid_send_report((uint8_t *)boot_report, sizeof(*boot_report));
+        } else {
+            err = zmk_usb_hid_send_report((uint8_t *)keyboard_report, sizeof(*keyboard_report));
+        }
         if (err) {
             LOG_ERR("FAILED TO SEND OVER USB: %d", err);
         }
@@ -95,15 +144,20 @@ static int send_keyboard_report() {
 #endif /* IS_ENABLED(CONFIG_ZMK_BLE) */
 
     default:
-        LOG_ERR("Unsupported endpoint %d", current_endpoint);
+        LOG_ERR("Unsupported endpoint %d", endpoint);
         return -ENOTSUP;
     }
 }
 
-static int send_consumer_report() {
+static int send_consumer_report_to_endpoint(enum zmk_endpoint endpoint) {
     struct zmk_hid_consumer_report *consumer_report = zmk_hid_get_consumer_report();
 
-    switch (current_endpoint) {
+    if (endpoint_is_boot_protocol(endpoint)) {
+        LOG_DBG("Boot protocol host, not sending consumer report");
+        return 0;
+    }
+
+    switch (endpoint) {
 #if IS_ENABLED(CONFIG_ZMK_USB)
     case ZMK_ENDPOINT_USB: {
         int err = zmk_usb_hid_send_report((uint8_t *)consumer_report, sizeof(*consumer_report));
@@ -125,11 +179,120 @@ static int send_consumer_report() {
 #endif /* IS_ENABLED(CONFIG_ZMK_BLE) */
 
     default:
-        LOG_ERR("Unsupported endpoint %d", current_endpoint);
+        LOG_ERR("Unsupported endpoint %d", endpoint);
+        return -ENOTSUP;
+    }
+}
+
+static bool is_usb_ready();
+static bool is_ble_ready();
+
+static bool is_endpoint_ready(enum zmk_endpoint endpoint) {
+    switch (endpoint) {
+    case ZMK_ENDPOINT_USB:
+        return is_usb_ready();
+    case ZMK_ENDPOINT_BLE:
+#if IS_ENABLED(CONFIG_ZMK_BLE)
+        // Broadcasts also reach the other connected profiles, even if the active one isn't.
+        return broadcast ? zmk_ble_connected_profile_count() > 0 : is_ble_ready();
+#else
+        return false;
+#endif /* IS_ENABLED(CONFIG_ZMK_BLE) */
+    default:
+        return false;
+    }
+}
+
+// Sends a report to the current endpoint, or while broadcasting to every ready endpoint. Each
+// endpoint queues reports on its own, so a slow link doesn't hold up the others. A broadcast only
+// counts as sent if every ready endpoint accepted it, otherwise the report isn't marked as sent
+// and an endpoint that missed e.g. a key release gets it with the next report.
+static int send_to_endpoints(int (*send)(enum zmk_endpoint endpoint)) {
+    if (!broadcast) {
+        return send(current_endpoint);
+    }
+
+    bool sent = false;
+    int ret = 0;
+    for (enum zmk_endpoint endpoint = ZMK_ENDPOINT_USB; endpoint <= ZMK_ENDPOINT_BLE; endpoint++) {
+        if (!is_endpoint_ready(endpoint)) {
+            continue;
+        }
+
+        int err = send(endpoint);
+        if (err) {
+            ret = err;
+        }
+        sent = true;
+    }
+    return sent ? ret : -ENODEV;
+}
+
+static int send_keyboard_report() {
+    if (!zmk_hid_keyboard_report_changed()) {
+        LOG_DBG("Keyboard report unchanged, not sending");
+        return 0;
+    }
+
+    int err = send_to_endpoints(send_keyboard_report_to_endpoint);
+    if (!err) {
+        zmk_hid_keyboard_report_sent();
+    }
+    return err;
+}
+
+static int send_consumer_report() {
+    if (!zmk_hid_consumer_report_changed()) {
+        LOG_DBG("Consumer report unchanged, not sending");
+        return 0;
+    }
+
+    int err = send_to_endpoints(send_consumer_report_to_endpoint);
+    if (!err) {
+        zmk_hid_consumer_report_sent();
+    }
+    return err;
+}
+
+#if IS_ENABLED(CONFIG_ZMK_MOUSE)
+static int send_mouse_report_to_endpoint(enum zmk_endpoint endpoint) {
+    struct zmk_hid_mouse_report *mouse_report = zmk_hid_get_mouse_report();
+
+    if (endpoint_is_boot_protocol(endpoint)) {
+        LOG_DBG("Boot protocol host, not sending mouse report");
+        return 0;
+    }
+
+    switch (endpoint) {
+#if IS_ENABLED(CONFIG_ZMK_USB)
+    case ZMK_ENDPOINT_USB: {
+        int err = zmk_usb_hid_send_report((uint8_t *)mouse_report, sizeof(*mouse_report));
+        if (err) {
+            LOG_ERR("FAILED TO SEND OVER USB: %d", err);
+        }
+        return err;
+    }
+#endif /* IS_ENABLED(CONFIG_ZMK_USB) */
+
+#if IS_ENABLED(CONFIG_ZMK_BLE)
+    case ZMK_ENDPOINT_BLE: {
+        int err = zmk_hog_send_mouse_report(&mouse_report->body);
+        if (err) {
+            LOG_ERR("FAILED TO SEND OVER HOG: %d", err);
+        }
+        return err;
+    }
+#endif /* IS_ENABLED(CONFIG_ZMK_BLE) */
+
+    default:
+        LOG_ERR("Unsupported endpoint %d", endpoint);
         return -ENOTSUP;
     }
 }
 
+int zmk_endpoints_send_mouse_report() { return send_to_endpoints(send_mouse_report_to_endpoint); }
+#endif /* IS_ENABLED(CONFIG_ZMK_MOUSE) */
+
 int zmk_endpoints_send_report(uint8_t usage_page) {
 
     LOG_DBG("usage page 0x%02X", usage_page);
@@ -163,6 +326,21 @@ static int endpoints_handle_set(const char *name, size_t len, settings_read_cb r
         }
 
         update_current_endpoint();
+    } else if (settings_name_steq(name, "broadcast", NULL)) {
+        if (len != sizeof(broadcast)) {
+            LOG_ERR("Invalid broadcast size (got %d expected %d)", len, sizeof(broadcast));
+            return -EINVAL;
+        }
+
+        int err = read_cb(cb_arg, &broadcast, sizeof(broadcast));
+        if (err <= 0) {
+            LOG_ERR("Failed to read broadcast from settings (err %d)", err);
+            return err;
+        }
+
+#if IS_ENABLED(CONFIG_ZMK_BLE)
+        zmk_hog_set_broadcast(broadcast);
+#endif /* IS_ENABLED(CONFIG_ZMK_BLE) */
     }
 
     return 0;
@@ -181,8 +359,6 @@ static int zmk_endpoints_init(const struct device *_arg) {
         return err;
     }
 
-    k_delayed_work_init(&endpoints_save_work, endpoints_save_preferred_work);
-
     settings_load_subtree("endpoints");
 #endif
 
@@ -231,22 +407,35 @@ static void disconnect_current_endpoint() {
 
     zmk_endpoints_send_report(HID_USAGE_KEY);
     zmk_endpoints_send_report(HID_USAGE_CONSUMER);
+
+#if IS_ENABLED(CONFIG_ZMK_MOUSE)
+    zmk_hid_mouse_clear();
+    zmk_endpoints_send_mouse_report();
+#endif
 }
 
 static void update_current_endpoint() {
     enum zmk_endpoint new_endpoint = get_selected_endpoint();
 
     if (new_endpoint != current_endpoint) {
-        /* Cancel all current keypresses so keys don't stay held on the old endpoint. */
-        disconnect_current_endpoint();
+        /* Cancel all current keypresses so keys don't stay held on the old endpoint. While
+         * broadcasting, the old endpoint still receives the reports. */
+        if (!broadcast) {
+            disconnect_current_endpoint();
+        }
 
         current_endpoint = new_endpoint;
         LOG_INF("Endpoint changed: %d", current_endpoint);
+
+        zmk_hid_indicators_endpoint_changed();
     }
 }
 
 static int endpoint_listener(const struct zmk_event_header *eh) {
     update_current_endpoint();
+    // The endpoint or the host connected to it changed, so the next reports must be sent even if
+    // they match what was last sent.
+    zmk_hid_reports_invalidate();
     return 0;
 }
 
@@ -0,0 +1,10 @@
+/*
+ * Copyright (c) 2020 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <kernel.h>
+#include <zmk/events/mouse-button-state-changed.h>
+
+ZMK_EVENT_IMPL(mouse_button_state_changed);
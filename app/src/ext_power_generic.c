@@ -13,6 +13,7 @@
 #include <settings/settings.h>
 #include <drivers/gpio.h>
 #include <drivers/ext_power.h>
+#include <zmk/settings.h>
 
 #if DT_HAS_COMPAT_STATUS_OKAY(DT_DRV_COMPAT)
 
@@ -33,23 +34,12 @@ struct ext_power_generic_data {
 #endif
 };
 
+static int ext_power_save_state(const struct device *dev) {
 #if IS_ENABLED(CONFIG_SETTINGS)
-static void ext_power_save_state_work(struct k_work *work) {
-    char setting_path[40];
-    const struct device *ext_power = device_get_binding(DT_INST_LABEL(0));
-    struct ext_power_generic_data *data = ext_power->data;
-
-    snprintf(setting_path, 40, "ext_power/state/%s", DT_INST_LABEL(0));
-    settings_save_one(setting_path, &data->status, sizeof(data->status));
-}
-
-static struct k_delayed_work ext_power_save_work;
-#endif
+    struct ext_power_generic_data *data = dev->data;
 
-int ext_power_save_state() {
-#if IS_ENABLED(CONFIG_SETTINGS)
-    k_delayed_work_cancel(&ext_power_save_work);
-    return k_delayed_work_submit(&ext_power_save_work, K_MSEC(CONFIG_ZMK_SETTINGS_SAVE_DEBOUNCE));
+    return zmk_settings_queue_save("ext_power/state/" DT_INST_LABEL(0), &data->status,
+                                   sizeof(data->status));
 #else
     return 0;
 #endif
@@ -64,7 +54,7 @@ static int ext_power_generic_enable(const struct device *dev) {
         return -EIO;
     }
     data->status = true;
-    return ext_power_save_state();
+    return ext_power_save_state(dev);
 }
 
 static int ext_power_generic_disable(const struct device *dev) {
@@ -76,7 +66,7 @@ static int ext_power_generic_disable(const struct device *dev) {
         return -EIO;
     }
     data->status = false;
-    return ext_power_save_state();
+    return ext_power_save_state(dev);
 }
 
 static int ext_power_generic_get(const struct device *dev) {
@@ -148,15 +138,10 @@ static int ext_power_generic_init(const struct device *dev) {
         return err;
     }
 
-    k_delayed_work_init(&ext_power_save_work, ext_power_save_state_work);
-
     // Set default value (on) if settings isn't set
     settings_load_subtree("ext_power");
     if (!data->settings_init) {
-
-        data->status = true;
-        k_delayed_work_submit(&ext_power_save_work, K_NO_WAIT);
-
+        // Enabling it also saves the state.
         ext_power_enable(dev);
     }
 #else
@@ -11,26 +11,66 @@ LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 #include <dt-bindings/zmk/modifiers.h>
 
 static struct zmk_hid_keyboard_report keyboard_report = {
-    .report_id = 1, .body = {.modifiers = 0, ._reserved = 0, .keys = {0}}};
+    .report_id = ZMK_HID_REPORT_ID_KEYBOARD, .body = {.modifiers = 0, ._reserved = 0, .keys = {0}}};
 
-static struct zmk_hid_consumer_report consumer_report = {.report_id = 2, .body = {.keys = {0}}};
+static struct zmk_hid_consumer_report consumer_report = {.report_id = ZMK_HID_REPORT_ID_CONSUMER,
+                                                        .body = {.keys = {0}}};
+
+// Built from keyboard_report on demand, so the boot protocol needs no state of its own.
+static struct zmk_hid_boot_report boot_report;
+
+// The report bodies that were last sent successfully, to skip sending identical reports.
+static struct zmk_hid_keyboard_report_body last_sent_keyboard_body;
+static struct zmk_hid_consumer_report_body last_sent_consumer_body;
+static bool last_sent_keyboard_valid = false;
+static bool last_sent_consumer_valid = false;
+
+#if IS_ENABLED(CONFIG_ZMK_MOUSE)
+static struct zmk_hid_mouse_report mouse_report = {.report_id = ZMK_HID_REPORT_ID_MOUSE,
+                                                  .body = {.buttons = 0}};
+#endif
 
 // Keep track of how often a modifier was pressed.
 // Only release the modifier if the count is 0.
 static int explicit_modifier_counts[8] = {0, 0, 0, 0, 0, 0, 0, 0};
 static zmk_mod_flags explicit_modifiers = 0;
 
+// Implicit modifiers of the currently pressed keys, in the order they were pressed. Only the
+// implicit modifiers of the most recently pressed key that is still held are applied. E.g. when
+// LC(A) is pressed, then LS(B), then LC(A) is released, B keeps its shift until it is released.
+#define ZMK_HID_IMPLICIT_MODIFIERS_MAX_KEYS 16
+
+struct implicit_modifiers_key {
+    uint8_t usage_page;
+    zmk_key key;
+    zmk_mod_flags modifiers;
+};
+
+static struct implicit_modifiers_key implicit_modifiers_keys[ZMK_HID_IMPLICIT_MODIFIERS_MAX_KEYS];
+static uint8_t implicit_modifiers_keys_len = 0;
+
+static zmk_mod_flags current_implicit_modifiers() {
+    if (implicit_modifiers_keys_len == 0) {
+        return 0;
+    }
+    return implicit_modifiers_keys[implicit_modifiers_keys_len - 1].modifiers;
+}
+
+zmk_mod_flags zmk_hid_get_implicit_modifiers() { return current_implicit_modifiers(); }
+
 #define SET_MODIFIERS(mods)                                                                        \
     {                                                                                              \
         keyboard_report.body.modifiers = mods;                                                     \
         LOG_DBG("Modifiers set to 0x%02X", keyboard_report.body.modifiers);                        \
     }
 
+#define APPLY_MODIFIERS() SET_MODIFIERS(explicit_modifiers | current_implicit_modifiers())
+
 int zmk_hid_register_mod(zmk_mod modifier) {
     explicit_modifier_counts[modifier]++;
     LOG_DBG("Modifier %d count %d", modifier, explicit_modifier_counts[modifier]);
     WRITE_BIT(explicit_modifiers, modifier, true);
-    SET_MODIFIERS(explicit_modifiers);
+    APPLY_MODIFIERS();
     return 0;
 }
 
@@ -45,19 +85,65 @@ int zmk_hid_unregister_mod(zmk_mod modifier) {
         LOG_DBG("Modifier %d released", modifier);
         WRITE_BIT(explicit_modifiers, modifier, false);
     }
-    SET_MODIFIERS(explicit_modifiers);
+    APPLY_MODIFIERS();
     return 0;
 }
 
-#define TOGGLE_KEYBOARD(match, val)                                                                \
-    for (int idx = 0; idx < ZMK_HID_KEYBOARD_NKRO_SIZE; idx++) {                                   \
-        if (keyboard_report.body.keys[idx] != match) {                                             \
+#define TOGGLE_KEYBOARD(keys, match, val)                                                          \
+    for (int idx = 0; idx < ARRAY_SIZE(keys); idx++) {                                            \
+        if (keys[idx] != match) {                                                                  \
             continue;                                                                              \
         }                                                                                          \
-        keyboard_report.body.keys[idx] = val;                                                      \
-        break;                                                                                     \
+        keys[idx] = val;                                                                           \
+        return 0;                                                                                  \
     }
 
+#if IS_ENABLED(CONFIG_ZMK_HID_REPORT_TYPE_NKRO)
+
+static int select_keyboard_usage(zmk_key usage) {
+    if (usage > ZMK_HID_KEYBOARD_NKRO_MAX_USAGE) {
+#if ZMK_HID_KEYBOARD_NKRO_OVERFLOW_SIZE > 0
+        TOGGLE_KEYBOARD(keyboard_report.body.overflow, 0U, usage);
+        LOG_WRN("Keyboard report is full, dropping keycode 0x%02X", usage);
+        return -ENOMEM;
+#else
+        LOG_ERR("Keycode 0x%02X is outside of the NKRO report", usage);
+        return -EINVAL;
+#endif
+    }
+    WRITE_BIT(keyboard_report.body.keys[usage / 8], usage % 8, true);
+    return 0;
+}
+
+static int deselect_keyboard_usage(zmk_key usage) {
+    if (usage > ZMK_HID_KEYBOARD_NKRO_MAX_USAGE) {
+#if ZMK_HID_KEYBOARD_NKRO_OVERFLOW_SIZE > 0
+        TOGGLE_KEYBOARD(keyboard_report.body.overflow, usage, 0U);
+        return 0;
+#else
+        LOG_ERR("Keycode 0x%02X is outside of the NKRO report", usage);
+        return -EINVAL;
+#endif
+    }
+    WRITE_BIT(keyboard_report.body.keys[usage / 8], usage % 8, false);
+    return 0;
+}
+
+#else
+
+static int select_keyboard_usage(zmk_key usage) {
+    TOGGLE_KEYBOARD(keyboard_report.body.keys, 0U, usage);
+    LOG_WRN("Keyboard report is full, dropping keycode 0x%02X", usage);
+    return -ENOMEM;
+}
+
+static int deselect_keyboard_usage(zmk_key usage) {
+    TOGGLE_KEYBOARD(keyboard_report.body.keys, usage, 0U);
+    return 0;
+}
+
+#endif /* IS_ENABLED(CONFIG_ZMK_HID_REPORT_TYPE_NKRO) */
+
 #define TOGGLE_CONSUMER(match, val)                                                                \
     for (int idx = 0; idx < ZMK_HID_CONSUMER_NKRO_SIZE; idx++) {                                   \
         if (consumer_report.body.keys[idx] != match) {                                             \
@@ -67,13 +153,35 @@ int zmk_hid_unregister_mod(zmk_mod modifier) {
         break;                                                                                     \
     }
 
-int zmk_hid_implicit_modifiers_press(zmk_mod_flags implicit_modifiers) {
-    SET_MODIFIERS(explicit_modifiers | implicit_modifiers);
+int zmk_hid_implicit_modifiers_press(uint8_t usage_page, zmk_key key,
+                                     zmk_mod_flags implicit_modifiers) {
+    if (implicit_modifiers_keys_len == ZMK_HID_IMPLICIT_MODIFIERS_MAX_KEYS) {
+        // Forget the oldest key, its modifiers can only apply again once all newer keys are up.
+        memmove(&implicit_modifiers_keys[0], &implicit_modifiers_keys[1],
+                sizeof(implicit_modifiers_keys[0]) * (ZMK_HID_IMPLICIT_MODIFIERS_MAX_KEYS - 1));
+        implicit_modifiers_keys_len--;
+    }
+
+    implicit_modifiers_keys[implicit_modifiers_keys_len++] = (struct implicit_modifiers_key){
+        .usage_page = usage_page,
+        .key = key,
+        .modifiers = implicit_modifiers,
+    };
+    APPLY_MODIFIERS();
     return 0;
 }
 
-int zmk_hid_implicit_modifiers_release() {
-    SET_MODIFIERS(explicit_modifiers);
+int zmk_hid_implicit_modifiers_release(uint8_t usage_page, zmk_key key) {
+    for (int i = implicit_modifiers_keys_len - 1; i >= 0; i--) {
+        struct implicit_modifiers_key *entry = &implicit_modifiers_keys[i];
+        if (entry->usage_page != usage_page || entry->key != key) {
+            continue;
+        }
+        memmove(entry, entry + 1, sizeof(*entry) * (implicit_modifiers_keys_len - i - 1));
+        implicit_modifiers_keys_len--;
+        break;
+    }
+    APPLY_MODIFIERS();
     return 0;
 }
 
@@ -81,36 +189,205 @@ int zmk_hid_keyboard_press(zmk_key code) {
     if (code >= HID_USAGE_KEY_KEYBOARD_LEFTCONTROL && code <= HID_USAGE_KEY_KEYBOARD_RIGHT_GUI) {
         return zmk_hid_register_mod(code - HID_USAGE_KEY_KEYBOARD_LEFTCONTROL);
     }
-    TOGGLE_KEYBOARD(0U, code);
-    return 0;
+    return select_keyboard_usage(code);
 };
 
 int zmk_hid_keyboard_release(zmk_key code) {
     if (code >= HID_USAGE_KEY_KEYBOARD_LEFTCONTROL && code <= HID_USAGE_KEY_KEYBOARD_RIGHT_GUI) {
         return zmk_hid_unregister_mod(code - HID_USAGE_KEY_KEYBOARD_LEFTCONTROL);
     }
-    TOGGLE_KEYBOARD(code, 0U);
-    return 0;
+    return deselect_keyboard_usage(code);
 };
 
-void zmk_hid_keyboard_clear() { memset(&keyboard_report.body, 0, sizeof(keyboard_report.body)); }
+void zmk_hid_keyboard_clear() {
+    implicit_modifiers_keys_len = 0;
+    memset(&keyboard_report.body, 0, sizeof(keyboard_report.body));
+}
+
+#if IS_ENABLED(CONFIG_ZMK_HID_CONSUMER_REPORT_BITMAP)
+
+#define CONSUMER_BITMAP_CASE(i, _)                                                                 \
+    case ZMK_HID_CONSUMER_BITMAP_USAGE(i):                                                         \
+        return i;
+
+static int consumer_bitmap_index(zmk_key usage) {
+    switch (usage) {
+        UTIL_LISTIFY(ZMK_HID_CONSUMER_BITMAP_USAGES, CONSUMER_BITMAP_CASE, _)
+    default:
+        return -ENOENT;
+    }
+}
+
+#endif /* IS_ENABLED(CONFIG_ZMK_HID_CONSUMER_REPORT_BITMAP) */
 
 int zmk_hid_consumer_press(zmk_key code) {
+#if IS_ENABLED(CONFIG_ZMK_HID_CONSUMER_REPORT_BITMAP)
+    int idx = consumer_bitmap_index(code);
+    if (idx >= 0) {
+        WRITE_BIT(consumer_report.body.bitmap, idx, true);
+        return 0;
+    }
+#endif
     TOGGLE_CONSUMER(0U, code);
     return 0;
 };
 
 int zmk_hid_consumer_release(zmk_key code) {
+#if IS_ENABLED(CONFIG_ZMK_HID_CONSUMER_REPORT_BITMAP)
+    int idx = consumer_bitmap_index(code);
+    if (idx >= 0) {
+        WRITE_BIT(consumer_report.body.bitmap, idx, false);
+        return 0;
+    }
+#endif
     TOGGLE_CONSUMER(code, 0U);
     return 0;
 };
 
 void zmk_hid_consumer_clear() { memset(&consumer_report.body, 0, sizeof(consumer_report.body)); }
 
+#if IS_ENABLED(CONFIG_ZMK_MOUSE)
+
+int zmk_hid_mouse_buttons_press(zmk_mouse_button_flags buttons) {
+    mouse_report.body.buttons |= buttons;
+    LOG_DBG("Mouse buttons set to 0x%02X", mouse_report.body.buttons);
+    return 0;
+}
+
+int zmk_hid_mouse_buttons_release(zmk_mouse_button_flags buttons) {
+    mouse_report.body.buttons &= ~buttons;
+    LOG_DBG("Mouse buttons set to 0x%02X", mouse_report.body.buttons);
+    return 0;
+}
+
+void zmk_hid_mouse_movement_set(int8_t x, int8_t y) {
+    mouse_report.body.x = x;
+    mouse_report.body.y = y;
+}
+
+void zmk_hid_mouse_scroll_set(int8_t scroll_x, int8_t scroll_y) {
+    mouse_report.body.scroll_x = scroll_x;
+    mouse_report.body.scroll_y = scroll_y;
+}
+
+void zmk_hid_mouse_clear() { memset(&mouse_report.body, 0, sizeof(mouse_report.body)); }
+
+#endif /* IS_ENABLED(CONFIG_ZMK_MOUSE) */
+
+bool zmk_hid_keyboard_report_changed() {
+    return !last_sent_keyboard_valid ||
+           memcmp(&last_sent_keyboard_body, &keyboard_report.body, sizeof(keyboard_report.body));
+}
+
+void zmk_hid_keyboard_report_sent() {
+    memcpy(&last_sent_keyboard_body, &keyboard_report.body, sizeof(keyboard_report.body));
+    last_sent_keyboard_valid = true;
+}
+
+bool zmk_hid_consumer_report_changed() {
+    return !last_sent_consumer_valid ||
+           memcmp(&last_sent_consumer_body, &consumer_report.body, sizeof(consumer_report.body));
+}
+
+void zmk_hid_consumer_report_sent() {
+    memcpy(&last_sent_consumer_body, &consumer_report.body, sizeof(consumer_report.body));
+    last_sent_consumer_valid = true;
+}
+
+void zmk_hid_reports_invalidate() {
+    last_sent_keyboard_valid = false;
+    last_sent_consumer_valid = false;
+}
+
+// A change is hidden if a byte that the queued report changed compared to the state before it is
+// changed again by the newer one, e.g. a key press followed by its release.
+bool zmk_hid_report_can_supersede(const uint8_t *previous, const uint8_t *queued,
+                                  const uint8_t *report, size_t len) {
+    for (int i = 0; i < len; i++) {
+        if (previous[i] != queued[i] && queued[i] != report[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+#if IS_ENABLED(CONFIG_ZMK_MOUSE)
+// The report descriptor limits movement to -127..127.
+#define MOUSE_DELTA_MAX 127
+
+static inline bool mouse_delta_fits(int8_t a, int8_t b) {
+    return a + b >= -MOUSE_DELTA_MAX && a + b <= MOUSE_DELTA_MAX;
+}
+
+static inline int8_t add_mouse_delta(int8_t a, int8_t b) {
+    return CLAMP(a + b, -MOUSE_DELTA_MAX, MOUSE_DELTA_MAX);
+}
+
+bool zmk_hid_mouse_report_can_merge(const struct zmk_hid_mouse_report_body *report,
+                                    const struct zmk_hid_mouse_report_body *earlier) {
+    return report->buttons == earlier->buttons && mouse_delta_fits(report->x, earlier->x) &&
+           mouse_delta_fits(report->y, earlier->y) &&
+           mouse_delta_fits(report->scroll_x, earlier->scroll_x) &&
+           mouse_delta_fits(report->scroll_y, earlier->scroll_y);
+}
+
+void zmk_hid_mouse_report_merge(struct zmk_hid_mouse_report_body *report,
+                                const struct zmk_hid_mouse_report_body *earlier) {
+    report->x = add_mouse_delta(report->x, earlier->x);
+    report->y = add_mouse_delta(report->y, earlier->y);
+    report->scroll_x = add_mouse_delta(report->scroll_x, earlier->scroll_x);
+    report->scroll_y = add_mouse_delta(report->scroll_y, earlier->scroll_y);
+}
+#endif /* IS_ENABLED(CONFIG_ZMK_MOUSE) */
+
 struct zmk_hid_keyboard_report *zmk_hid_get_keyboard_report() {
     return &keyboard_report;
 }
 
+#if IS_ENABLED(CONFIG_ZMK_HID_REPORT_TYPE_NKRO)
+static bool add_boot_report_key(int *count, zmk_key usage) {
+    if (*count == ZMK_HID_BOOT_KEYBOARD_SIZE) {
+        // Like any 6KRO keyboard, report the rollover error instead of an arbitrary subset.
+        memset(boot_report.keys, HID_USAGE_KEY_KEYBOARD_ERRORROLLOVER, sizeof(boot_report.keys));
+        return false;
+    }
+    boot_report.keys[(*count)++] = usage;
+    return true;
+}
+#endif /* IS_ENABLED(CONFIG_ZMK_HID_REPORT_TYPE_NKRO) */
+
+struct zmk_hid_boot_report *zmk_hid_get_boot_report() {
+    boot_report.modifiers = keyboard_report.body.modifiers;
+    boot_report._reserved = 0;
+#if IS_ENABLED(CONFIG_ZMK_HID_REPORT_TYPE_NKRO)
+    memset(boot_report.keys, 0, sizeof(boot_report.keys));
+    int count = 0;
+    for (zmk_key usage = 0; usage <= ZMK_HID_KEYBOARD_NKRO_MAX_USAGE; usage++) {
+        if ((keyboard_report.body.keys[usage / 8] & BIT(usage % 8)) &&
+            !add_boot_report_key(&count, usage)) {
+            return &boot_report;
+        }
+    }
+#if ZMK_HID_KEYBOARD_NKRO_OVERFLOW_SIZE > 0
+    for (int i = 0; i < ZMK_HID_KEYBOARD_NKRO_OVERFLOW_SIZE; i++) {
+        zmk_key usage = keyboard_report.body.overflow[i];
+        if (usage != 0 && !add_boot_report_key(&count, usage)) {
+            return &boot_report;
+        }
+    }
+#endif
+#else
+    memcpy(boot_report.keys, keyboard_report.body.keys, sizeof(boot_report.keys));
+#endif /* IS_ENABLED(CONFIG_ZMK_HID_REPORT_TYPE_NKRO) */
+    return &boot_report;
+}
+
 struct zmk_hid_consumer_report *zmk_hid_get_consumer_report() {
     return &consumer_report;
 }
+
+#if IS_ENABLED(CONFIG_ZMK_MOUSE)
+struct zmk_hid_mouse_report *zmk_hid_get_mouse_report() {
+    return &mouse_report;
+}
+#endif /* IS_ENABLED(CONFIG_ZMK_MOUSE) */
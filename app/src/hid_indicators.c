@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2020 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <kernel.h>
+#include <logging/log.h>
+
+LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
+
+#include <zmk/endpoints.h>
+#include <zmk/hid_indicators.h>
+#include <zmk/event-manager.h>
+#include <zmk/events/host-indicators-changed.h>
+#include <zmk/events/ble-active-profile-changed.h>
+#include <zmk/events/usb-conn-state-changed.h>
+
+// Each host reports its own lock state, so only the one of the selected endpoint is current.
+static zmk_hid_indicators usb_indicators = 0;
+static zmk_hid_indicators ble_indicators = 0;
+
+static zmk_hid_indicators current_indicators = 0;
+
+zmk_hid_indicators zmk_hid_indicators_get_current() { return current_indicators; }
+
+static zmk_hid_indicators indicators_for_endpoint(enum zmk_endpoint endpoint) {
+    switch (endpoint) {
+    case ZMK_ENDPOINT_USB:
+        return usb_indicators;
+    case ZMK_ENDPOINT_BLE:
+        return ble_indicators;
+    default:
+        return 0;
+    }
+}
+
+static void update_current_indicators() {
+    zmk_hid_indicators indicators = indicators_for_endpoint(zmk_endpoints_selected());
+    if (indicators == current_indicators) {
+        return;
+    }
+
+    current_indicators = indicators;
+    LOG_DBG("Host indicators changed to 0x%02X", indicators);
+
+    struct host_indicators_changed *ev = new_host_indicators_changed();
+    ev->indicators = indicators;
+    ZMK_EVENT_RAISE(ev);
+}
+
+void zmk_hid_indicators_process_report(enum zmk_endpoint endpoint, zmk_hid_indicators indicators) {
+    switch (endpoint) {
+    case ZMK_ENDPOINT_USB:
+        usb_indicators = indicators;
+        break;
+    case ZMK_ENDPOINT_BLE:
+        ble_indicators = indicators;
+        break;
+    default:
+        LOG_ERR("Unsupported endpoint %d", endpoint);
+        return;
+    }
+
+    update_current_indicators();
+}
+
+void zmk_hid_indicators_endpoint_changed() { update_current_indicators(); }
+
+static int hid_indicators_listener(const struct zmk_event_header *eh) {
+    // A new host sends its own state once it is connected, until then nothing is lit.
+#if IS_ENABLED(CONFIG_ZMK_USB)
+    if (is_usb_conn_state_changed(eh) &&
+        cast_usb_conn_state_changed(eh)->conn_state != ZMK_USB_CONN_HID) {
+        usb_indicators = 0;
+    }
+#endif /* IS_ENABLED(CONFIG_ZMK_USB) */
+#if IS_ENABLED(CONFIG_ZMK_BLE)
+    if (is_ble_active_profile_changed(eh)) {
+        ble_indicators = 0;
+    }
+#endif /* IS_ENABLED(CONFIG_ZMK_BLE) */
+
+    update_current_indicators();
+    return 0;
+}
+
+ZMK_LISTENER(hid_indicators_listener, hid_indicators_listener);
+#if IS_ENABLED(CONFIG_ZMK_USB)
+ZMK_SUBSCRIPTION(hid_indicators_listener, usb_conn_state_changed);
+#endif /* IS_ENABLED(CONFIG_ZMK_USB) */
+#if IS_ENABLED(CONFIG_ZMK_BLE)
+ZMK_SUBSCRIPTION(hid_indicators_listener, ble_active_profile_changed);
+#endif /* IS_ENABLED(CONFIG_ZMK_BLE) */
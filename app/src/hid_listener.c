@@ -4,6 +4,7 @@
  * SPDX-License-Identifier: MIT
  */
 
+#include <init.h>
 #include <drivers/behavior.h>
 #include <logging/log.h>
 
@@ -12,15 +13,139 @@ LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 #include <zmk/event-manager.h>
 #include <zmk/events/keycode-state-changed.h>
 #include <zmk/events/modifiers-state-changed.h>
+#include <zmk/events/mouse-button-state-changed.h>
 #include <zmk/hid.h>
 #include <dt-bindings/zmk/hid_usage_pages.h>
 #include <zmk/endpoints.h>
+#include <zmk/hid_listener.h>
+#include <zmk/latency.h>
+
+#if IS_ENABLED(CONFIG_ZMK_HID_REPORT_COALESCING)
+
+// Keycode changes that are not sent yet. They are sent together once the current event processing
+// pass is done, or after CONFIG_ZMK_HID_REPORT_COALESCING_WINDOW_US.
+#define HID_LISTENER_BATCH_MAX_CHANGES 8
+
+struct hid_listener_change {
+    uint8_t usage_page;
+    uint32_t keycode;
+};
+
+static struct hid_listener_change batch_changes[HID_LISTENER_BATCH_MAX_CHANGES];
+static uint8_t batch_changes_len = 0;
+static bool batch_keyboard_changed = false;
+static bool batch_consumer_changed = false;
+
+static struct k_delayed_work batch_flush_work;
+
+static void hid_listener_flush_batch() {
+    if (batch_changes_len == 0) {
+        return;
+    }
+
+    LOG_DBG("Sending %d batched changes", batch_changes_len);
+    k_delayed_work_cancel(&batch_flush_work);
+    batch_changes_len = 0;
+
+    if (batch_keyboard_changed) {
+        batch_keyboard_changed = false;
+        zmk_endpoints_send_report(HID_USAGE_KEY);
+    }
+    if (batch_consumer_changed) {
+        batch_consumer_changed = false;
+        zmk_endpoints_send_report(HID_USAGE_CONSUMER);
+    }
+    zmk_latency_release_scan();
+}
+
+static void hid_listener_batch_flush_work_handler(struct k_work *work) {
+    hid_listener_flush_batch();
+}
+
+static bool hid_listener_batch_contains(uint8_t usage_page, uint32_t keycode) {
+    for (int i = 0; i < batch_changes_len; i++) {
+        if (batch_changes[i].usage_page == usage_page && batch_changes[i].keycode == keycode) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static inline bool is_modifier_keycode(uint8_t usage_page, uint32_t keycode) {
+    return usage_page == HID_USAGE_KEY && keycode >= HID_USAGE_KEY_KEYBOARD_LEFTCONTROL &&
+           keycode <= HID_USAGE_KEY_KEYBOARD_RIGHT_GUI;
+}
+
+// Send the pending changes first if merging this change into them would change what the host
+// sees: a second change of the same key (e.g. a tap) must be its own report, and a modifier
+// change must not apply to keys that were pressed before it.
+static void hid_listener_prepare_change(uint8_t usage_page, uint32_t keycode,
+                                        zmk_mod_flags implicit_modifiers) {
+    if (batch_changes_len == 0) {
+        return;
+    }
+
+    if (batch_changes_len == HID_LISTENER_BATCH_MAX_CHANGES ||
+        hid_listener_batch_contains(usage_page, keycode) ||
+        is_modifier_keycode(usage_page, keycode) || implicit_modifiers != 0 ||
+        zmk_hid_get_implicit_modifiers() != 0) {
+        hid_listener_flush_batch();
+    }
+}
+
+static int hid_listener_report_changed(uint8_t usage_page, uint32_t keycode) {
+    switch (usage_page) {
+    case HID_USAGE_KEY:
+        batch_keyboard_changed = true;
+        break;
+    case HID_USAGE_CONSUMER:
+        batch_consumer_changed = true;
+        break;
+    default:
+        return zmk_endpoints_send_report(usage_page);
+    }
+
+    batch_changes[batch_changes_len++] = (struct hid_listener_change){
+        .usage_page = usage_page,
+        .keycode = keycode,
+    };
+
+    if (batch_changes_len == 1) {
+        // The batch is sent after the scan processing finished, which would drop the scan.
+        zmk_latency_hold_scan();
+        // Work submitted now runs once the work item that is processing events has finished.
+        k_delayed_work_submit(&batch_flush_work,
+                              K_USEC(CONFIG_ZMK_HID_REPORT_COALESCING_WINDOW_US));
+    }
+    return 0;
+}
+
+static int hid_listener_init(const struct device *_arg) {
+    k_delayed_work_init(&batch_flush_work, hid_listener_batch_flush_work_handler);
+    return 0;
+}
+
+SYS_INIT(hid_listener_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+
+#else
+
+static inline void hid_listener_flush_batch() {}
+
+static inline void hid_listener_prepare_change(uint8_t usage_page, uint32_t keycode,
+                                               zmk_mod_flags implicit_modifiers) {}
+
+static inline int hid_listener_report_changed(uint8_t usage_page, uint32_t keycode) {
+    return zmk_endpoints_send_report(usage_page);
+}
+
+#endif /* IS_ENABLED(CONFIG_ZMK_HID_REPORT_COALESCING) */
 
 static int hid_listener_keycode_pressed(uint8_t usage_page, uint32_t keycode,
                                         zmk_mod_flags implicit_modifiers) {
     int err;
     LOG_DBG("usage_page 0x%02X keycode 0x%02X mods 0x%02X", usage_page, keycode,
             implicit_modifiers);
+    hid_listener_prepare_change(usage_page, keycode, implicit_modifiers);
     switch (usage_page) {
     case HID_USAGE_KEY:
         err = zmk_hid_keyboard_press(keycode);
@@ -37,8 +162,8 @@ static int hid_listener_keycode_pressed(uint8_t usage_page, uint32_t keycode,
         }
         break;
     }
-    zmk_hid_implicit_modifiers_press(implicit_modifiers);
-    return zmk_endpoints_send_report(usage_page);
+    zmk_hid_implicit_modifiers_press(usage_page, keycode, implicit_modifiers);
+    return hid_listener_report_changed(usage_page, keycode);
 }
 
 static int hid_listener_keycode_released(uint8_t usage_page, uint32_t keycode,
@@ -46,6 +171,7 @@ static int hid_listener_keycode_released(uint8_t usage_page, uint32_t keycode,
     int err;
     LOG_DBG("usage_page 0x%02X keycode 0x%02X mods 0x%02X", usage_page, keycode,
             implicit_modifiers);
+    hid_listener_prepare_change(usage_page, keycode, implicit_modifiers);
     switch (usage_page) {
     case HID_USAGE_KEY:
         err = zmk_hid_keyboard_release(keycode);
@@ -61,15 +187,57 @@ static int hid_listener_keycode_released(uint8_t usage_page, uint32_t keycode,
             return err;
         }
     }
-    // There is a minor issue with this code.
-    // If LC(A) is pressed, then LS(B), then LC(A) is released, the shift for B will be released
-    // prematurely. This causes if LS(B) to repeat like Bbbbbbbb when pressed for a long time.
-    // Solving this would require keeping track of which key's implicit modifiers are currently
-    // active and only releasing modifiers at that time.
-    zmk_hid_implicit_modifiers_release();
-    return zmk_endpoints_send_report(usage_page);
+    zmk_hid_implicit_modifiers_release(usage_page, keycode);
+    return hid_listener_report_changed(usage_page, keycode);
 }
 
+static int hid_listener_toggle_usage(uint8_t usage_page, uint32_t keycode, bool pressed) {
+    int err;
+    hid_listener_prepare_change(usage_page, keycode, 0);
+    switch (usage_page) {
+    case HID_USAGE_KEY:
+        err = pressed ? zmk_hid_keyboard_press(keycode) : zmk_hid_keyboard_release(keycode);
+        break;
+    case HID_USAGE_CONSUMER:
+        err = pressed ? zmk_hid_consumer_press(keycode) : zmk_hid_consumer_release(keycode);
+        break;
+    default:
+        return -ENOTSUP;
+    }
+    if (err) {
+        return err;
+    }
+    return hid_listener_report_changed(usage_page, keycode);
+}
+
+int zmk_hid_listener_resend_usage(uint8_t usage_page, uint32_t keycode) {
+    // The press changes the same usage as the pending release, so it is never combined with it.
+    int err = hid_listener_toggle_usage(usage_page, keycode, false);
+    if (err) {
+        return err;
+    }
+    return hid_listener_toggle_usage(usage_page, keycode, true);
+}
+
+#if IS_ENABLED(CONFIG_ZMK_MOUSE)
+static int hid_listener_mouse_buttons_changed(zmk_mouse_button_flags buttons, bool pressed) {
+    int err;
+    LOG_DBG("buttons 0x%02X state %d", buttons, pressed);
+    if (pressed) {
+        err = zmk_hid_mouse_buttons_press(buttons);
+    } else {
+        err = zmk_hid_mouse_buttons_release(buttons);
+    }
+    if (err) {
+        LOG_ERR("Unable to change mouse buttons");
+        return err;
+    }
+    // Keyboard changes made before, e.g. the modifier of a modified click, must be sent first.
+    hid_listener_flush_batch();
+    return zmk_endpoints_send_mouse_report();
+}
+#endif /* IS_ENABLED(CONFIG_ZMK_MOUSE) */
+
 int hid_listener(const struct zmk_event_header *eh) {
     if (is_keycode_state_changed(eh)) {
         const struct keycode_state_changed *ev = cast_keycode_state_changed(eh);
@@ -79,8 +247,17 @@ int hid_listener(const struct zmk_event_header *eh) {
             hid_listener_keycode_released(ev->usage_page, ev->keycode, ev->implicit_modifiers);
         }
     }
+#if IS_ENABLED(CONFIG_ZMK_MOUSE)
+    else if (is_mouse_button_state_changed(eh)) {
+        const struct mouse_button_state_changed *ev = cast_mouse_button_state_changed(eh);
+        hid_listener_mouse_buttons_changed(ev->buttons, ev->state);
+    }
+#endif /* IS_ENABLED(CONFIG_ZMK_MOUSE) */
     return 0;
 }
 
 ZMK_LISTENER(hid_listener, hid_listener);
-ZMK_SUBSCRIPTION(hid_listener, keycode_state_changed);
\ No newline at end of file
+ZMK_SUBSCRIPTION(hid_listener, keycode_state_changed);
+#if IS_ENABLED(CONFIG_ZMK_MOUSE)
+ZMK_SUBSCRIPTION(hid_listener, mouse_button_state_changed);
+#endif /* IS_ENABLED(CONFIG_ZMK_MOUSE) */
\ No newline at end of file
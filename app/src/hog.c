@@ -4,6 +4,7 @@
  * SPDX-License-Identifier: MIT
  */
 
+#include <init.h>
 #include <settings/settings.h>
 
 #include <logging/log.h>
@@ -14,8 +15,12 @@ LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 #include <bluetooth/gatt.h>
 
 #include <zmk/ble.h>
+#include <zmk/event-manager.h>
+#include <zmk/events/ble-active-profile-changed.h>
 #include <zmk/hog.h>
 #include <zmk/hid.h>
+#include <zmk/hid_indicators.h>
+#include <zmk/raw_hid.h>
 
 enum {
     HIDS_REMOTE_WAKE = BIT(0),
@@ -39,6 +44,11 @@ static struct hids_info info = {
     .flags = HIDS_NORMALLY_CONNECTABLE & HIDS_REMOTE_WAKE,
 };
 
+enum {
+    HIDS_PROTOCOL_MODE_BOOT = 0x00,
+    HIDS_PROTOCOL_MODE_REPORT = 0x01,
+};
+
 enum {
     HIDS_INPUT = 0x01,
     HIDS_OUTPUT = 0x02,
@@ -46,18 +56,43 @@ enum {
 };
 
 static struct hids_report input = {
-    .id = 0x01,
+    .id = ZMK_HID_REPORT_ID_KEYBOARD,
     .type = HIDS_INPUT,
 };
 
 static struct hids_report consumer_input = {
-    .id = 0x02,
+    .id = ZMK_HID_REPORT_ID_CONSUMER,
+    .type = HIDS_INPUT,
+};
+
+static struct hids_report led_output = {
+    .id = ZMK_HID_REPORT_ID_KEYBOARD,
+    .type = HIDS_OUTPUT,
+};
+
+#if IS_ENABLED(CONFIG_ZMK_RAW_HID)
+static struct hids_report raw_input = {
+    .id = ZMK_HID_REPORT_ID_RAW,
     .type = HIDS_INPUT,
 };
 
-static bool host_requests_notification = false;
+static struct hids_report raw_output = {
+    .id = ZMK_HID_REPORT_ID_RAW,
+    .type = HIDS_OUTPUT,
+};
+
+static struct zmk_hid_raw_report_body raw_input_report;
+#endif /* IS_ENABLED(CONFIG_ZMK_RAW_HID) */
+
+#if IS_ENABLED(CONFIG_ZMK_MOUSE)
+static struct hids_report mouse_input = {
+    .id = ZMK_HID_REPORT_ID_MOUSE,
+    .type = HIDS_INPUT,
+};
+#endif /* IS_ENABLED(CONFIG_ZMK_MOUSE) */
+
 static uint8_t ctrl_point;
-// static uint8_t proto_mode;
+static struct zmk_hid_led_report_body led_output_report;
 
 static ssize_t read_hids_info(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf,
                               uint16_t len, uint16_t offset) {
@@ -92,17 +127,111 @@ static ssize_t read_hids_consumer_input_report(struct bt_conn *conn,
                              sizeof(struct zmk_hid_consumer_report_body));
 }
 
-// static ssize_t write_proto_mode(struct bt_conn *conn,
-//                                 const struct bt_gatt_attr *attr,
-//                                 const void *buf, uint16_t len, uint16_t offset,
-//                                 uint8_t flags)
-// {
-//     printk("PROTO CHANGED\n");
-//     return 0;
-// }
+#if IS_ENABLED(CONFIG_ZMK_MOUSE)
+static ssize_t read_hids_mouse_input_report(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                                            void *buf, uint16_t len, uint16_t offset) {
+    struct zmk_hid_mouse_report_body *report_body = &zmk_hid_get_mouse_report()->body;
+    return bt_gatt_attr_read(conn, attr, buf, len, offset, report_body,
+                             sizeof(struct zmk_hid_mouse_report_body));
+}
+#endif /* IS_ENABLED(CONFIG_ZMK_MOUSE) */
+
+static ssize_t read_hids_boot_kb_input_report(struct bt_conn *conn,
+                                              const struct bt_gatt_attr *attr, void *buf,
+                                              uint16_t len, uint16_t offset) {
+    struct zmk_hid_boot_report *report = zmk_hid_get_boot_report();
+    return bt_gatt_attr_read(conn, attr, buf, len, offset, report,
+                             sizeof(struct zmk_hid_boot_report));
+}
+
+static void clear_queued_reports(struct bt_conn *conn);
+static uint8_t get_proto_mode(struct bt_conn *conn);
+static void set_proto_mode(struct bt_conn *conn, uint8_t mode);
+
+static ssize_t read_proto_mode(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf,
+                               uint16_t len, uint16_t offset) {
+    uint8_t value = get_proto_mode(conn);
+    return bt_gatt_attr_read(conn, attr, buf, len, offset, &value, sizeof(value));
+}
+
+static ssize_t write_proto_mode(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                                const void *buf, uint16_t len, uint16_t offset, uint8_t flags) {
+    uint8_t value;
+
+    if (offset != 0) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+    }
+    if (len != sizeof(value)) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+    }
+
+    value = *((uint8_t *)buf);
+    if (value != HIDS_PROTOCOL_MODE_BOOT && value != HIDS_PROTOCOL_MODE_REPORT) {
+        return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+    }
+
+    LOG_DBG("HOG protocol mode changed to %s",
+            value == HIDS_PROTOCOL_MODE_BOOT ? "boot" : "report");
+    set_proto_mode(conn, value);
+    // Queued reports were built for the previous protocol.
+    clear_queued_reports(conn);
+    zmk_hid_reports_invalidate();
+    return len;
+}
+
+// The boot and the report protocol output reports are the same, so both share one handler.
+static ssize_t read_hids_output_report(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                                       void *buf, uint16_t len, uint16_t offset) {
+    return bt_gatt_attr_read(conn, attr, buf, len, offset, &led_output_report,
+                             sizeof(struct zmk_hid_led_report_body));
+}
+
+static ssize_t write_hids_output_report(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                                        const void *buf, uint16_t len, uint16_t offset,
+                                        uint8_t flags) {
+    if (offset != 0) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+    }
+    if (len != sizeof(struct zmk_hid_led_report_body)) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+    }
+
+    // With several hosts connected, only the state of the active one is shown.
+    if (conn != zmk_ble_active_profile_conn()) {
+        return len;
+    }
+
+    memcpy(&led_output_report, buf, len);
+    zmk_hid_indicators_process_report(ZMK_ENDPOINT_BLE, led_output_report.indicators);
+    return len;
+}
+
+#if IS_ENABLED(CONFIG_ZMK_RAW_HID)
+static ssize_t read_hids_raw_input_report(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                                          void *buf, uint16_t len, uint16_t offset) {
+    return bt_gatt_attr_read(conn, attr, buf, len, offset, &raw_input_report,
+                             sizeof(struct zmk_hid_raw_report_body));
+}
+
+static ssize_t write_hids_raw_output_report(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                                            const void *buf, uint16_t len, uint16_t offset,
+                                            uint8_t flags) {
+    if (offset != 0) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+    }
+    if (len != sizeof(struct zmk_hid_raw_report_body)) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+    }
+    if (zmk_raw_hid_receive(ZMK_ENDPOINT_BLE, conn, buf, len)) {
+        return BT_GATT_ERR(BT_ATT_ERR_INSUFFICIENT_RESOURCES);
+    }
+    return len;
+}
+#endif /* IS_ENABLED(CONFIG_ZMK_RAW_HID) */
 
+// The stack keeps the subscriptions of each connection, see send_report_to.
 static void input_ccc_changed(const struct bt_gatt_attr *attr, uint16_t value) {
-    host_requests_notification = (value == BT_GATT_CCC_NOTIFY) ? 1 : 0;
+    LOG_DBG("Input report notifications %s", value == BT_GATT_CCC_NOTIFY ? "enabled" : "disabled");
 }
 
 static ssize_t write_ctrl_point(struct bt_conn *conn, const struct bt_gatt_attr *attr,
@@ -121,8 +250,6 @@ static ssize_t write_ctrl_point(struct bt_conn *conn, const struct bt_gatt_attr
 /* HID Service Declaration */
 BT_GATT_SERVICE_DEFINE(
     hog_svc, BT_GATT_PRIMARY_SERVICE(BT_UUID_HIDS),
-    //    BT_GATT_CHARACTERISTIC(BT_UUID_HIDS_PROTOCOL_MODE, BT_GATT_CHRC_WRITE_WITHOUT_RESP,
-    //                           BT_GATT_PERM_WRITE, NULL, write_proto_mode, &proto_mode),
     BT_GATT_CHARACTERISTIC(BT_UUID_HIDS_INFO, BT_GATT_CHRC_READ, BT_GATT_PERM_READ, read_hids_info,
                            NULL, &info),
     BT_GATT_CHARACTERISTIC(BT_UUID_HIDS_REPORT_MAP, BT_GATT_CHRC_READ, BT_GATT_PERM_READ,
@@ -138,46 +265,782 @@ BT_GATT_SERVICE_DEFINE(
     BT_GATT_CCC(input_ccc_changed, BT_GATT_PERM_READ_ENCRYPT | BT_GATT_PERM_WRITE_ENCRYPT),
     BT_GATT_DESCRIPTOR(BT_UUID_HIDS_REPORT_REF, BT_GATT_PERM_READ, read_hids_report_ref, NULL,
                        &consumer_input),
+#if IS_ENABLED(CONFIG_ZMK_MOUSE)
+    BT_GATT_CHARACTERISTIC(BT_UUID_HIDS_REPORT, BT_GATT_CHRC_READ | BT_GATT_CHRC_NOTIFY,
+                           BT_GATT_PERM_READ_ENCRYPT, read_hids_mouse_input_report, NULL, NULL),
+    BT_GATT_CCC(input_ccc_changed, BT_GATT_PERM_READ_ENCRYPT | BT_GATT_PERM_WRITE_ENCRYPT),
+    BT_GATT_DESCRIPTOR(BT_UUID_HIDS_REPORT_REF, BT_GATT_PERM_READ, read_hids_report_ref, NULL,
+                       &mouse_input),
+#endif /* IS_ENABLED(CONFIG_ZMK_MOUSE) */
     BT_GATT_CHARACTERISTIC(BT_UUID_HIDS_CTRL_POINT, BT_GATT_CHRC_WRITE_WITHOUT_RESP,
-                           BT_GATT_PERM_WRITE, NULL, write_ctrl_point, &ctrl_point));
+                           BT_GATT_PERM_WRITE, NULL, write_ctrl_point, &ctrl_point),
+    // The boot protocol characteristics come last, so the report attribute indices stay the same.
+    BT_GATT_CHARACTERISTIC(BT_UUID_HIDS_PROTOCOL_MODE,
+                           BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE_WITHOUT_RESP,
+                           BT_GATT_PERM_READ_ENCRYPT | BT_GATT_PERM_WRITE_ENCRYPT, read_proto_mode,
+                           write_proto_mode, NULL),
+    BT_GATT_CHARACTERISTIC(BT_UUID_HIDS_BOOT_KB_IN_REPORT, BT_GATT_CHRC_READ | BT_GATT_CHRC_NOTIFY,
+                           BT_GATT_PERM_READ_ENCRYPT, read_hids_boot_kb_input_report, NULL, NULL),
+    BT_GATT_CCC(input_ccc_changed, BT_GATT_PERM_READ_ENCRYPT | BT_GATT_PERM_WRITE_ENCRYPT),
+    BT_GATT_CHARACTERISTIC(BT_UUID_HIDS_BOOT_KB_OUT_REPORT,
+                           BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE |
+                               BT_GATT_CHRC_WRITE_WITHOUT_RESP,
+                           BT_GATT_PERM_READ_ENCRYPT | BT_GATT_PERM_WRITE_ENCRYPT,
+                           read_hids_output_report, write_hids_output_report, NULL),
+    BT_GATT_CHARACTERISTIC(BT_UUID_HIDS_REPORT,
+                           BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE |
+                               BT_GATT_CHRC_WRITE_WITHOUT_RESP,
+                           BT_GATT_PERM_READ_ENCRYPT | BT_GATT_PERM_WRITE_ENCRYPT,
+                           read_hids_output_report, write_hids_output_report, NULL),
+    BT_GATT_DESCRIPTOR(BT_UUID_HIDS_REPORT_REF, BT_GATT_PERM_READ, read_hids_report_ref, NULL,
+                       &led_output),
+#if IS_ENABLED(CONFIG_ZMK_RAW_HID)
+    BT_GATT_CHARACTERISTIC(BT_UUID_HIDS_REPORT, BT_GATT_CHRC_READ | BT_GATT_CHRC_NOTIFY,
+                           BT_GATT_PERM_READ_ENCRYPT, read_hids_raw_input_report, NULL, NULL),
+    BT_GATT_CCC(input_ccc_changed, BT_GATT_PERM_READ_ENCRYPT | BT_GATT_PERM_WRITE_ENCRYPT),
+    BT_GATT_DESCRIPTOR(BT_UUID_HIDS_REPORT_REF, BT_GATT_PERM_READ, read_hids_report_ref, NULL,
+                       &raw_input),
+    BT_GATT_CHARACTERISTIC(BT_UUID_HIDS_REPORT,
+                           BT_GATT_CHRC_WRITE | BT_GATT_CHRC_WRITE_WITHOUT_RESP,
+                           BT_GATT_PERM_WRITE_ENCRYPT, NULL, write_hids_raw_output_report, NULL),
+    BT_GATT_DESCRIPTOR(BT_UUID_HIDS_REPORT_REF, BT_GATT_PERM_READ, read_hids_report_ref, NULL,
+                       &raw_output),
+#endif /* IS_ENABLED(CONFIG_ZMK_RAW_HID) */
+);
+
+#if IS_ENABLED(CONFIG_ZMK_MOUSE)
+#define HOG_BOOT_KB_INPUT_ATTR_IDX 22
+#define HOG_RAW_INPUT_ATTR_IDX 30
+#else
+#define HOG_BOOT_KB_INPUT_ATTR_IDX 18
+#define HOG_RAW_INPUT_ATTR_IDX 26
+#endif
 
 struct bt_conn *destination_connection() {
-    struct bt_conn *conn;
-    bt_addr_le_t *addr = zmk_ble_active_profile_addr();
-    LOG_DBG("Address pointer %p", addr);
-    if (!bt_addr_le_cmp(addr, BT_ADDR_LE_ANY)) {
-        LOG_WRN("Not sending, no active address for current profile");
-        return NULL;
-    } else if ((conn = bt_conn_lookup_addr_le(BT_ID_DEFAULT, addr)) == NULL) {
+    struct bt_conn *conn = zmk_ble_active_profile_conn();
+    if (conn == NULL) {
         LOG_WRN("Not sending, not connected to active profile");
-        return NULL;
     }
 
     return conn;
 }
 
-int zmk_hog_send_keyboard_report(struct zmk_hid_keyboard_report_body *report) {
-    struct bt_conn *conn = destination_connection();
-    if (conn == NULL) {
+// Reports are queued per connection and handed to the stack with bt_gatt_notify_cb, keeping at
+// most CONFIG_ZMK_HOG_MAX_NOTIFY_IN_FLIGHT notifications outstanding. Completion callbacks send
+// the next queued report, and a report the stack has no buffer for stays queued and is retried,
+// so a release is never dropped when the controller's TX buffers are full.
+enum hog_report_slot {
+    HOG_REPORT_KEYBOARD,
+    HOG_REPORT_BOOT_KEYBOARD,
+    HOG_REPORT_CONSUMER,
+#if IS_ENABLED(CONFIG_ZMK_MOUSE)
+    HOG_REPORT_MOUSE,
+#endif
+#if IS_ENABLED(CONFIG_ZMK_RAW_HID)
+    HOG_REPORT_RAW,
+#endif
+    HOG_REPORT_SLOT_COUNT,
+};
+
+static const uint8_t hog_report_attr_idx[HOG_REPORT_SLOT_COUNT] = {
+    [HOG_REPORT_KEYBOARD] = 5,
+    [HOG_REPORT_BOOT_KEYBOARD] = HOG_BOOT_KB_INPUT_ATTR_IDX,
+    [HOG_REPORT_CONSUMER] = 10,
+#if IS_ENABLED(CONFIG_ZMK_MOUSE)
+    [HOG_REPORT_MOUSE] = 13,
+#endif
+#if IS_ENABLED(CONFIG_ZMK_RAW_HID)
+    [HOG_REPORT_RAW] = HOG_RAW_INPUT_ATTR_IDX,
+#endif
+};
+
+#define HOG_KEYS_REPORT_SIZE                                                                       \
+    MAX(sizeof(struct zmk_hid_keyboard_report_body), sizeof(struct zmk_hid_consumer_report_body))
+
+#if IS_ENABLED(CONFIG_ZMK_MOUSE)
+#define HOG_STATE_REPORT_SIZE MAX(HOG_KEYS_REPORT_SIZE, sizeof(struct zmk_hid_mouse_report_body))
+#else
+#define HOG_STATE_REPORT_SIZE HOG_KEYS_REPORT_SIZE
+#endif
+
+#if IS_ENABLED(CONFIG_ZMK_RAW_HID)
+#define HOG_MAX_REPORT_SIZE MAX(HOG_STATE_REPORT_SIZE, sizeof(struct zmk_hid_raw_report_body))
+#else
+#define HOG_MAX_REPORT_SIZE HOG_STATE_REPORT_SIZE
+#endif
+
+// Delay before retrying a notification the stack had no buffer for, if there's no outstanding
+// notification whose completion would trigger the retry.
+#define HOG_RETRY_DELAY K_MSEC(5)
+
+struct hog_report {
+    uint8_t slot;
+    uint8_t len;
+    uint8_t data[MAX(HOG_MAX_REPORT_SIZE, sizeof(struct zmk_hid_boot_report))];
+};
+
+struct hog_report_queue {
+    struct bt_conn *conn;
+    struct hog_report reports[CONFIG_ZMK_HOG_REPORT_QUEUE_SIZE];
+    uint8_t head;
+    uint8_t len;
+    uint8_t in_flight;
+    // Each host picks its own protocol, e.g. a BIOS on one profile uses the boot protocol while
+    // the other hosts stay in the report protocol.
+    uint8_t proto_mode;
+    // The last report handed to the stack for each slot.
+    struct hog_report last_sent[HOG_REPORT_SLOT_COUNT];
+    struct k_delayed_work retry_work;
+    // Cycle counts at which the in flight notifications were sent, oldest first at sent_head.
+    // Notifications of a connection complete in the order they were sent.
+    uint32_t sent_cycles[CONFIG_ZMK_HOG_MAX_NOTIFY_IN_FLIGHT];
+    uint8_t sent_head;
+    struct zmk_hog_stats stats;
+#if IS_ENABLED(CONFIG_ZMK_HOG_EVENT_ALIGNED_TX)
+    // Cycle count of the last notification completion, which marks a connection event.
+    uint32_t last_event_cycles;
+    bool last_event_valid;
+    bool release_pending;
+    struct k_delayed_work release_work;
+#endif /* IS_ENABLED(CONFIG_ZMK_HOG_EVENT_ALIGNED_TX) */
+};
+
+static struct hog_report_queue report_queues[CONFIG_BT_MAX_CONN];
+
+static inline struct hog_report *queued_report(struct hog_report_queue *queue, uint8_t idx) {
+    return &queue->reports[(queue->head + idx) % CONFIG_ZMK_HOG_REPORT_QUEUE_SIZE];
+}
+
+static void store_report(struct hog_report *dest, uint8_t slot, const void *data, size_t len) {
+    dest->slot = slot;
+    dest->len = len;
+    memcpy(dest->data, data, len);
+}
+
+static void reset_report_queue(struct hog_report_queue *queue) {
+    unsigned int key = irq_lock();
+    queue->len = 0;
+    queue->in_flight = 0;
+    queue->sent_head = 0;
+    memset(queue->last_sent, 0, sizeof(queue->last_sent));
+#if IS_ENABLED(CONFIG_ZMK_HOG_EVENT_ALIGNED_TX)
+    queue->last_event_valid = false;
+    queue->release_pending = false;
+#endif /* IS_ENABLED(CONFIG_ZMK_HOG_EVENT_ALIGNED_TX) */
+    irq_unlock(key);
+    k_delayed_work_cancel(&queue->retry_work);
+#if IS_ENABLED(CONFIG_ZMK_HOG_EVENT_ALIGNED_TX)
+    k_delayed_work_cancel(&queue->release_work);
+#endif /* IS_ENABLED(CONFIG_ZMK_HOG_EVENT_ALIGNED_TX) */
+}
+
+static struct hog_report_queue *find_report_queue(struct bt_conn *conn) {
+    for (int i = 0; i < ARRAY_SIZE(report_queues); i++) {
+        if (report_queues[i].conn == conn) {
+            return &report_queues[i];
+        }
+    }
+
+    return NULL;
+}
+
+int zmk_hog_get_stats(struct bt_conn *conn, struct zmk_hog_stats *stats) {
+    struct hog_report_queue *queue = find_report_queue(conn);
+    if (conn == NULL || queue == NULL) {
         return -ENOTCONN;
     }
 
-    LOG_DBG("Sending to NULL? %s", conn == NULL ? "yes" : "no");
+    unsigned int key = irq_lock();
+    *stats = queue->stats;
+    stats->queue_depth = queue->len;
+    irq_unlock(key);
+    return 0;
+}
 
-    int err = bt_gatt_notify(conn, &hog_svc.attrs[5], report,
-                             sizeof(struct zmk_hid_keyboard_report_body));
-    bt_conn_unref(conn);
-    return err;
+static void record_notify_latency(struct hog_report_queue *queue) {
+    uint32_t sent = queue->sent_cycles[queue->sent_head];
+    uint32_t us = k_cyc_to_us_floor32(k_cycle_get_32() - sent);
+
+    queue->sent_head = (queue->sent_head + 1) % CONFIG_ZMK_HOG_MAX_NOTIFY_IN_FLIGHT;
+    queue->stats.latency_count++;
+    queue->stats.latency_total_us += us;
+    queue->stats.latency_min_us = MIN(queue->stats.latency_min_us, us);
+    queue->stats.latency_max_us = MAX(queue->stats.latency_max_us, us);
+}
+
+static uint8_t get_proto_mode(struct bt_conn *conn) {
+    struct hog_report_queue *queue = find_report_queue(conn);
+    return queue ? queue->proto_mode : HIDS_PROTOCOL_MODE_REPORT;
+}
+
+static void set_proto_mode(struct bt_conn *conn, uint8_t mode) {
+    struct hog_report_queue *queue = find_report_queue(conn);
+    if (queue != NULL) {
+        queue->proto_mode = mode;
+    }
+}
+
+bool zmk_hog_is_boot_protocol(struct bt_conn *conn) {
+    return get_proto_mode(conn) == HIDS_PROTOCOL_MODE_BOOT;
+}
+
+static void clear_queued_reports(struct bt_conn *conn) {
+    struct hog_report_queue *queue = find_report_queue(conn);
+    if (queue == NULL) {
+        return;
+    }
+
+    unsigned int key = irq_lock();
+    queue->len = 0;
+    irq_unlock(key);
+}
+
+static void flush_report_queue(struct hog_report_queue *queue);
+
+#if IS_ENABLED(CONFIG_ZMK_HOG_EVENT_ALIGNED_TX)
+
+// Zephyr doesn't tell the application when connection events happen, but a notification completes
+// right after the event that carried it, and events follow each other at the connection interval.
+// New reports are held back until just before the next estimated event, so reports that change
+// within one interval go out together, possibly superseding each other, without arriving at the
+// host any later than they would have if they'd waited in the controller. Without a recent
+// completion to estimate from, reports are sent right away.
+#define HOG_EVENT_ESTIMATE_MAX_AGE_US (1000 * USEC_PER_MSEC)
+
+static void mark_connection_event(struct hog_report_queue *queue) {
+    queue->last_event_cycles = k_cycle_get_32();
+    queue->last_event_valid = true;
+}
+
+static void forget_connection_events(struct hog_report_queue *queue) {
+    queue->last_event_valid = false;
+}
+
+static int32_t time_until_release_us(struct hog_report_queue *queue) {
+    struct bt_conn_info info;
+
+    if (!queue->last_event_valid || bt_conn_get_info(queue->conn, &info)) {
+        return 0;
+    }
+
+    uint32_t since_event_us = k_cyc_to_us_floor32(k_cycle_get_32() - queue->last_event_cycles);
+    if (since_event_us > HOG_EVENT_ESTIMATE_MAX_AGE_US) {
+        return 0;
+    }
+
+    // The connection interval is in units of 1.25 ms.
+    uint32_t interval_us = info.le.interval * 1250;
+    uint32_t until_event_us = interval_us - since_event_us % interval_us;
+    return (int32_t)until_event_us - CONFIG_ZMK_HOG_EVENT_ALIGNED_TX_GUARD_US;
+}
+
+static void schedule_flush(struct hog_report_queue *queue) {
+    int32_t delay_us = time_until_release_us(queue);
+    if (delay_us <= 0) {
+        flush_report_queue(queue);
+        return;
+    }
+
+    // Reports queued while a release is pending go out with it.
+    unsigned int key = irq_lock();
+    bool pending = queue->release_pending;
+    queue->release_pending = true;
+    irq_unlock(key);
+
+    if (!pending) {
+        k_delayed_work_submit(&queue->release_work, K_USEC(delay_us));
+    }
+}
+
+static void release_work_handler(struct k_work *work) {
+    struct hog_report_queue *queue = CONTAINER_OF(work, struct hog_report_queue, release_work);
+
+    unsigned int key = irq_lock();
+    queue->release_pending = false;
+    irq_unlock(key);
+
+    flush_report_queue(queue);
+}
+
+#else
+
+static inline void mark_connection_event(struct hog_report_queue *queue) {}
+static inline void forget_connection_events(struct hog_report_queue *queue) {}
+static inline void schedule_flush(struct hog_report_queue *queue) { flush_report_queue(queue); }
+
+#endif /* IS_ENABLED(CONFIG_ZMK_HOG_EVENT_ALIGNED_TX) */
+
+static void notify_complete(struct bt_conn *conn, void *user_data) {
+    struct hog_report_queue *queue = user_data;
+
+    unsigned int key = irq_lock();
+    // Completions of a connection that has since gone away are ignored.
+    if (queue->conn != conn || queue->in_flight == 0) {
+        irq_unlock(key);
+        return;
+    }
+    record_notify_latency(queue);
+    queue->in_flight--;
+    mark_connection_event(queue);
+    irq_unlock(key);
+
+    schedule_flush(queue);
+}
+
+static void flush_report_queue(struct hog_report_queue *queue) {
+    while (true) {
+        unsigned int key = irq_lock();
+        if (queue->conn == NULL || queue->len == 0 ||
+            queue->in_flight >= CONFIG_ZMK_HOG_MAX_NOTIFY_IN_FLIGHT) {
+            irq_unlock(key);
+            return;
+        }
+
+        // Counted as in flight before sending, so a concurrent flush doesn't send it twice.
+        struct hog_report report = *queued_report(queue, 0);
+        queue->head = (queue->head + 1) % CONFIG_ZMK_HOG_REPORT_QUEUE_SIZE;
+        queue->len--;
+        queue->sent_cycles[(queue->sent_head + queue->in_flight) %
+                           CONFIG_ZMK_HOG_MAX_NOTIFY_IN_FLIGHT] = k_cycle_get_32();
+        queue->in_flight++;
+        irq_unlock(key);
+
+        struct bt_gatt_notify_params params = {
+            .attr = &hog_svc.attrs[hog_report_attr_idx[report.slot]],
+            .data = report.data,
+            .len = report.len,
+            .func = notify_complete,
+            .user_data = queue,
+        };
+
+        int err = bt_gatt_notify_cb(queue->conn, &params);
+
+        key = irq_lock();
+        if (err == 0) {
+            queue->last_sent[report.slot] = report;
+            queue->stats.notify_sent++;
+            irq_unlock(key);
+            continue;
+        }
+
+        queue->in_flight--;
+        queue->stats.notify_failed++;
+        switch (err) {
+        case -ENOMEM:
+        case -ENOBUFS:
+        case -EAGAIN:
+        case -EBUSY:
+            break;
+        case -ENOTCONN:
+            irq_unlock(key);
+            LOG_WRN("Dropping queued reports, not connected");
+            reset_report_queue(queue);
+            return;
+        default:
+            irq_unlock(key);
+            LOG_ERR("Failed to notify report (err %d)", err);
+            continue;
+        }
+
+        // Put the report back in front, the stack is out of buffers and a later flush retries it.
+        queue->head = (queue->head + CONFIG_ZMK_HOG_REPORT_QUEUE_SIZE - 1) %
+                      CONFIG_ZMK_HOG_REPORT_QUEUE_SIZE;
+        *queued_report(queue, 0) = report;
+        queue->len++;
+        bool wait_for_completion = queue->in_flight > 0;
+        irq_unlock(key);
+
+        LOG_DBG("Notification deferred (err %d)", err);
+        if (!wait_for_completion) {
+            k_delayed_work_submit(&queue->retry_work, HOG_RETRY_DELAY);
+        }
+        return;
+    }
+}
+
+static void retry_work_handler(struct k_work *work) {
+    flush_report_queue(CONTAINER_OF(work, struct hog_report_queue, retry_work));
+}
+
+// A queued report can be replaced by a newer one for the same slot, unless that would hide a
+// change from the host.
+static bool can_supersede(const struct hog_report *previous, const struct hog_report *queued,
+                          const uint8_t *report, size_t len) {
+    return queued->len == len && previous->len == len &&
+           zmk_hid_report_can_supersede(previous->data, queued->data, report, len);
+}
+
+static inline bool is_mouse_report(uint8_t slot) {
+#if IS_ENABLED(CONFIG_ZMK_MOUSE)
+    return slot == HOG_REPORT_MOUSE;
+#else
+    return false;
+#endif
+}
+
+static inline bool is_raw_report(uint8_t slot) {
+#if IS_ENABLED(CONFIG_ZMK_RAW_HID)
+    return slot == HOG_REPORT_RAW;
+#else
+    return false;
+#endif
+}
+
+// Mouse reports carry movement deltas and raw HID frames are messages, so neither is state that a
+// newer report can replace.
+static inline bool is_state_report(uint8_t slot) {
+    return !is_mouse_report(slot) && !is_raw_report(slot);
+}
+
+#if IS_ENABLED(CONFIG_ZMK_MOUSE)
+// Adds a mouse report to the newest queued one instead of queueing it, if that keeps every change.
+// If the queue is full they're combined anyway, the buttons then end up in their latest state.
+static bool merge_mouse_report(struct hog_report_queue *queue, struct hog_report *newest,
+                               const uint8_t *report, size_t len) {
+    const struct zmk_hid_mouse_report_body *earlier =
+        (const struct zmk_hid_mouse_report_body *)newest->data;
+    struct zmk_hid_mouse_report_body merged = *(const struct zmk_hid_mouse_report_body *)report;
+
+    if (queue->len < CONFIG_ZMK_HOG_REPORT_QUEUE_SIZE &&
+        !zmk_hid_mouse_report_can_merge(&merged, earlier)) {
+        return false;
+    }
+
+    zmk_hid_mouse_report_merge(&merged, earlier);
+    store_report(newest, HOG_REPORT_MOUSE, &merged, len);
+    return true;
+}
+#else
+static inline bool merge_mouse_report(struct hog_report_queue *queue, struct hog_report *newest,
+                                      const uint8_t *report, size_t len) {
+    return false;
+}
+#endif /* IS_ENABLED(CONFIG_ZMK_MOUSE) */
+
+// Every slot can keep one queued entry, so a full queue always has an entry that can give way.
+BUILD_ASSERT(CONFIG_ZMK_HOG_REPORT_QUEUE_SIZE > HOG_REPORT_SLOT_COUNT,
+             "The HOG report queue needs room for more reports than there are report slots");
+
+static void remove_queued_report(struct hog_report_queue *queue, uint8_t idx) {
+    for (int i = idx; i < queue->len - 1; i++) {
+        *queued_report(queue, i) = *queued_report(queue, i + 1);
+    }
+    queue->len--;
+}
+
+// Index of the next queued entry for the same slot as the one at idx, or -1 if there is none.
+static int next_queued_index(struct hog_report_queue *queue, uint8_t idx) {
+    uint8_t slot = queued_report(queue, idx)->slot;
+    for (int i = idx + 1; i < queue->len; i++) {
+        if (queued_report(queue, i)->slot == slot) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Frees an entry of a full queue, so a key release still fits when e.g. mouse movement or raw HID
+// frames filled it. The oldest mouse report that has a later one is added to it, otherwise the
+// oldest raw HID frame is dropped, otherwise the oldest state report that a later one of the same
+// slot supersedes.
+static bool make_room(struct hog_report_queue *queue) {
+    int raw = -1;
+    int superseded = -1;
+
+    for (int i = 0; i < queue->len; i++) {
+        struct hog_report *entry = queued_report(queue, i);
+        int next = next_queued_index(queue, i);
+#if IS_ENABLED(CONFIG_ZMK_MOUSE)
+        if (is_mouse_report(entry->slot) && next >= 0) {
+            zmk_hid_mouse_report_merge(
+                (struct zmk_hid_mouse_report_body *)queued_report(queue, next)->data,
+                (const struct zmk_hid_mouse_report_body *)entry->data);
+            remove_queued_report(queue, i);
+            return true;
+        }
+#endif /* IS_ENABLED(CONFIG_ZMK_MOUSE) */
+        if (is_raw_report(entry->slot) && raw < 0) {
+            raw = i;
+        } else if (is_state_report(entry->slot) && next >= 0 && superseded < 0) {
+            superseded = i;
+        }
+    }
+
+    if (raw >= 0) {
+        LOG_WRN("HOG report queue is full, dropping a raw HID frame");
+        remove_queued_report(queue, raw);
+        return true;
+    }
+    if (superseded >= 0) {
+        remove_queued_report(queue, superseded);
+        return true;
+    }
+    return false;
+}
+
+static int queue_report(struct hog_report_queue *queue, uint8_t slot, const uint8_t *report,
+                        size_t len) {
+    struct hog_report *newest = NULL;
+    struct hog_report *previous = NULL;
+
+    for (int i = queue->len - 1; i >= 0; i--) {
+        struct hog_report *entry = queued_report(queue, i);
+        if (entry->slot != slot) {
+            continue;
+        }
+        if (newest == NULL) {
+            newest = entry;
+        } else {
+            previous = entry;
+            break;
+        }
+    }
+
+    if (newest != NULL && is_mouse_report(slot) &&
+        merge_mouse_report(queue, newest, report, len)) {
+        return 0;
+    }
+
+    if (newest != NULL && is_state_report(slot)) {
+        if (previous == NULL) {
+            previous = &queue->last_sent[slot];
+        }
+        // If the queue is full, keep the final state rather than dropping it, so no key gets stuck.
+        if (queue->len == CONFIG_ZMK_HOG_REPORT_QUEUE_SIZE ||
+            can_supersede(previous, newest, report, len)) {
+            store_report(newest, slot, report, len);
+            return 0;
+        }
+    }
+
+    if (queue->len == CONFIG_ZMK_HOG_REPORT_QUEUE_SIZE && !make_room(queue)) {
+        LOG_WRN("HOG report queue is full");
+        return -ENOMEM;
+    }
+
+    store_report(queued_report(queue, queue->len++), slot, report, len);
+    queue->stats.max_queue_depth = MAX(queue->stats.max_queue_depth, queue->len);
+    return 0;
+}
+
+static bool broadcast = false;
+
+void zmk_hog_set_broadcast(bool enable) { broadcast = enable; }
+
+static int send_report_to(struct bt_conn *conn, uint8_t slot, const void *report, size_t len) {
+    struct hog_report_queue *queue = find_report_queue(conn);
+    if (queue == NULL) {
+        return -ENOTCONN;
+    }
+
+    // Hosts in the boot protocol, like a BIOS or KVM, only understand the boot keyboard report.
+    if (queue->proto_mode == HIDS_PROTOCOL_MODE_BOOT) {
+        switch (slot) {
+        case HOG_REPORT_KEYBOARD:
+            slot = HOG_REPORT_BOOT_KEYBOARD;
+            report = zmk_hid_get_boot_report();
+            len = sizeof(struct zmk_hid_boot_report);
+            break;
+        case HOG_REPORT_BOOT_KEYBOARD:
+            break;
+        default:
+            LOG_DBG("Boot protocol host, not sending report for slot %d", slot);
+            return 0;
+        }
+    }
+
+    // A host that didn't subscribe to the report reads the current state once it does.
+    if (!bt_gatt_is_subscribed(conn, &hog_svc.attrs[hog_report_attr_idx[slot]],
+                               BT_GATT_CCC_NOTIFY)) {
+        LOG_DBG("Host isn't subscribed to report slot %d", slot);
+        return 0;
+    }
+
+    unsigned int key = irq_lock();
+    int err = queue_report(queue, slot, report, len);
+    irq_unlock(key);
+    if (err) {
+        return err;
+    }
+
+    schedule_flush(queue);
+    return 0;
+}
+
+// Every host has its own queue, so a slow host doesn't hold up the others. A broadcast fails if
+// any connected host didn't accept it, so the report isn't marked as sent.
+static int send_report(uint8_t slot, const void *report, size_t len) {
+    if (!broadcast) {
+        struct bt_conn *conn = destination_connection();
+        if (conn == NULL) {
+            return -ENOTCONN;
+        }
+
+        return send_report_to(conn, slot, report, len);
+    }
+
+    bool sent = false;
+    int ret = 0;
+    for (int i = 0; i < zmk_ble_profile_count(); i++) {
+        struct bt_conn *conn = zmk_ble_profile_conn(i);
+        if (conn == NULL) {
+            continue;
+        }
+
+        int err = send_report_to(conn, slot, report, len);
+        if (err) {
+            ret = err;
+        }
+        sent = true;
+    }
+    return sent ? ret : -ENOTCONN;
+}
+
+int zmk_hog_send_keyboard_report(struct zmk_hid_keyboard_report_body *report) {
+    return send_report(HOG_REPORT_KEYBOARD, report, sizeof(struct zmk_hid_keyboard_report_body));
 };
 
 int zmk_hog_send_consumer_report(struct zmk_hid_consumer_report_body *report) {
-    struct bt_conn *conn = destination_connection();
+    return send_report(HOG_REPORT_CONSUMER, report, sizeof(struct zmk_hid_consumer_report_body));
+};
+
+#if IS_ENABLED(CONFIG_ZMK_MOUSE)
+int zmk_hog_send_mouse_report(struct zmk_hid_mouse_report_body *report) {
+    return send_report(HOG_REPORT_MOUSE, report, sizeof(struct zmk_hid_mouse_report_body));
+};
+#endif /* IS_ENABLED(CONFIG_ZMK_MOUSE) */
+
+#if IS_ENABLED(CONFIG_ZMK_RAW_HID)
+int zmk_hog_send_raw_report(struct bt_conn *conn, const struct zmk_hid_raw_report_body *report) {
     if (conn == NULL) {
         return -ENOTCONN;
     }
 
-    int err = bt_gatt_notify(conn, &hog_svc.attrs[10], report,
-                             sizeof(struct zmk_hid_consumer_report_body));
+    // Raw HID responses are meant for the host that made the request, so they aren't broadcast.
+    raw_input_report = *report;
+    return send_report_to(conn, HOG_REPORT_RAW, report, sizeof(struct zmk_hid_raw_report_body));
+};
+#endif /* IS_ENABLED(CONFIG_ZMK_RAW_HID) */
+
+// The host reports were last sent to. When the active profile changes while that host stays
+// connected, it gets empty reports so no key stays held on it.
+static struct bt_conn *last_destination;
+
+static void release_all_on(struct bt_conn *conn) {
+    struct hog_report_queue *queue = find_report_queue(conn);
+    if (queue == NULL) {
+        return;
+    }
+
+    struct zmk_hid_keyboard_report_body keyboard = {0};
+    struct zmk_hid_boot_report boot_keyboard = {0};
+    struct zmk_hid_consumer_report_body consumer = {0};
+
+    unsigned int key = irq_lock();
+    if (queue->proto_mode == HIDS_PROTOCOL_MODE_BOOT) {
+        queue_report(queue, HOG_REPORT_BOOT_KEYBOARD, (uint8_t *)&boot_keyboard,
+                     sizeof(boot_keyboard));
+    } else {
+        queue_report(queue, HOG_REPORT_KEYBOARD, (uint8_t *)&keyboard, sizeof(keyboard));
+        queue_report(queue, HOG_REPORT_CONSUMER, (uint8_t *)&consumer, sizeof(consumer));
+#if IS_ENABLED(CONFIG_ZMK_MOUSE)
+        struct zmk_hid_mouse_report_body mouse = {0};
+        queue_report(queue, HOG_REPORT_MOUSE, (uint8_t *)&mouse, sizeof(mouse));
+#endif /* IS_ENABLED(CONFIG_ZMK_MOUSE) */
+    }
+    irq_unlock(key);
+
+    flush_report_queue(queue);
+}
+
+static int hog_profile_changed_listener(const struct zmk_event_header *eh) {
+    struct bt_conn *conn = zmk_ble_active_profile_conn();
+    if (conn == last_destination) {
+        return 0;
+    }
+
+    // While broadcasting, the previous host keeps receiving the reports.
+    if (last_destination != NULL && !broadcast) {
+        release_all_on(last_destination);
+    }
+    if (last_destination != NULL) {
+        bt_conn_unref(last_destination);
+    }
+
+    last_destination = conn ? bt_conn_ref(conn) : NULL;
+    return 0;
+}
+
+ZMK_LISTENER(hog, hog_profile_changed_listener);
+ZMK_SUBSCRIPTION(hog, ble_active_profile_changed);
+
+static void hog_connected(struct bt_conn *conn, uint8_t err) {
+    if (err) {
+        return;
+    }
+
+    struct hog_report_queue *queue = find_report_queue(NULL);
+    if (queue == NULL) {
+        LOG_ERR("No free HOG report queue");
+        return;
+    }
+
+    reset_report_queue(queue);
+    // Each connection starts out in the report protocol mode.
+    queue->proto_mode = HIDS_PROTOCOL_MODE_REPORT;
+    queue->stats = (struct zmk_hog_stats){.latency_min_us = UINT32_MAX};
+    queue->conn = bt_conn_ref(conn);
+}
+
+static void hog_disconnected(struct bt_conn *conn, uint8_t reason) {
+    struct hog_report_queue *queue = find_report_queue(conn);
+    if (queue == NULL) {
+        return;
+    }
+
+    reset_report_queue(queue);
+    queue->conn = NULL;
     bt_conn_unref(conn);
-    return err;
+
+    if (conn == last_destination) {
+        bt_conn_unref(last_destination);
+        last_destination = NULL;
+    }
+}
+
+#if IS_ENABLED(CONFIG_ZMK_HOG_EVENT_ALIGNED_TX)
+// A new interval moves the connection events, so the old estimate no longer applies.
+static void hog_param_updated(struct bt_conn *conn, uint16_t interval, uint16_t latency,
+                              uint16_t timeout) {
+    struct hog_report_queue *queue = find_report_queue(conn);
+    if (queue == NULL) {
+        return;
+    }
+
+    unsigned int key = irq_lock();
+    forget_connection_events(queue);
+    irq_unlock(key);
+}
+#endif /* IS_ENABLED(CONFIG_ZMK_HOG_EVENT_ALIGNED_TX) */
+
+static struct bt_conn_cb conn_callbacks = {
+    .connected = hog_connected,
+    .disconnected = hog_disconnected,
+#if IS_ENABLED(CONFIG_ZMK_HOG_EVENT_ALIGNED_TX)
+    .le_param_updated = hog_param_updated,
+#endif /* IS_ENABLED(CONFIG_ZMK_HOG_EVENT_ALIGNED_TX) */
 };
+
+static int zmk_hog_protocol_init(const struct device *_arg) {
+    for (int i = 0; i < ARRAY_SIZE(report_queues); i++) {
+        k_delayed_work_init(&report_queues[i].retry_work, retry_work_handler);
+#if IS_ENABLED(CONFIG_ZMK_HOG_EVENT_ALIGNED_TX)
+        k_delayed_work_init(&report_queues[i].release_work, release_work_handler);
+#endif /* IS_ENABLED(CONFIG_ZMK_HOG_EVENT_ALIGNED_TX) */
+    }
+
+    bt_conn_cb_register(&conn_callbacks);
+    return 0;
+}
+
+SYS_INIT(zmk_hog_protocol_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
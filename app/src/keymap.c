@@ -4,6 +4,7 @@
  * SPDX-License-Identifier: MIT
  */
 
+#include <string.h>
 #include <sys/util.h>
 #include <logging/log.h>
 LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
@@ -115,6 +116,57 @@ int zmk_keymap_layer_toggle(uint8_t layer) {
     return zmk_keymap_layer_activate(layer);
 };
 
+uint8_t zmk_keymap_layer_count() { return ZMK_KEYMAP_LAYERS_LEN; }
+
+int zmk_keymap_get_binding(uint8_t layer, uint32_t position, struct zmk_behavior_binding *binding) {
+    if (layer >= ZMK_KEYMAP_LAYERS_LEN || position >= ZMK_KEYMAP_LEN) {
+        return -EINVAL;
+    }
+
+    *binding = zmk_keymap[layer][position];
+    return 0;
+}
+
+// Only the nodes under /behaviors implement the behavior driver API, any other device, e.g. a GPIO
+// controller, has an API struct of a different type.
+#define BEHAVIOR_LABEL(node) DT_PROP_OR(node, label, ""),
+
+static const char *const behavior_labels[] = {DT_FOREACH_CHILD(DT_PATH(behaviors), BEHAVIOR_LABEL)};
+
+static bool is_behavior(const struct device *dev) {
+    for (int i = 0; i < ARRAY_SIZE(behavior_labels); i++) {
+        if (strcmp(dev->name, behavior_labels[i]) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Replaces a binding until the next reboot. If the key is held while its binding is replaced, the
+// release goes to the new binding, so bindings should only be replaced while the key is up.
+int zmk_keymap_set_binding(uint8_t layer, uint32_t position,
+                           const struct zmk_behavior_binding *binding) {
+    if (layer >= ZMK_KEYMAP_LAYERS_LEN || position >= ZMK_KEYMAP_LEN) {
+        return -EINVAL;
+    }
+
+    // Keep a pointer to the device name, which lives as long as the firmware.
+    const struct device *behavior = device_get_binding(binding->behavior_dev);
+    if (behavior == NULL || !is_behavior(behavior)) {
+        LOG_ERR("Unknown behavior %s", log_strdup(binding->behavior_dev));
+        return -ENODEV;
+    }
+
+    zmk_keymap[layer][position] = (struct zmk_behavior_binding){
+        .behavior_dev = (char *)behavior->name,
+        .param1 = binding->param1,
+        .param2 = binding->param2,
+    };
+    LOG_DBG("layer: %d position: %d, binding name: %s", layer, position,
+            log_strdup(behavior->name));
+    return 0;
+}
+
 bool is_active_layer(uint8_t layer, zmk_keymap_layers_state layer_state) {
     return (layer_state & BIT(layer)) == BIT(layer) || layer == _zmk_keymap_layer_default;
 }
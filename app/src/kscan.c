@@ -11,6 +11,7 @@
 
 LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 
+#include <zmk/latency.h>
 #include <zmk/matrix_transform.h>
 #include <zmk/event-manager.h>
 #include <zmk/events/position-state-changed.h>
@@ -37,6 +38,7 @@ static void zmk_kscan_callback(const struct device *dev, uint32_t row, uint32_t
         .column = column,
         .state = (pressed ? ZMK_KSCAN_EVENT_STATE_PRESSED : ZMK_KSCAN_EVENT_STATE_RELEASED)};
 
+    zmk_latency_scan_detected();
     k_msgq_put(&zmk_kscan_msgq, &ev, K_NO_WAIT);
     k_work_submit(&msg_processor.work);
 }
@@ -56,6 +58,7 @@ void zmk_kscan_process_msgq(struct k_work *item) {
         pos_ev->timestamp = k_uptime_get();
         ZMK_EVENT_RAISE(pos_ev);
     }
+    zmk_latency_scan_processed();
 }
 
 int zmk_kscan_init(char *name) {
@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2020 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <kernel.h>
+#include <logging/log.h>
+
+LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
+
+#include <zmk/latency.h>
+
+// Timestamps are in hardware cycles, since the uptime in ms is too coarse for a 1 ms poll rate.
+static bool scan_pending = false;
+static uint32_t pending_scan_time;
+// Set while the reports for the pending scan are held back to be combined, so finishing the scan
+// processing doesn't drop it before they're sent.
+static bool scan_held = false;
+
+static struct zmk_latency_stats stats = {.min_us = UINT32_MAX};
+
+void zmk_latency_scan_detected() {
+    unsigned int key = irq_lock();
+    // Keep the oldest scan, since the next report has to wait for that one too.
+    if (!scan_pending) {
+        scan_pending = true;
+        pending_scan_time = k_cycle_get_32();
+    }
+    irq_unlock(key);
+}
+
+void zmk_latency_scan_processed() {
+    unsigned int key = irq_lock();
+    // A scan that didn't produce a report, e.g. a layer change or a key released while the report
+    // was suppressed, would otherwise be charged to whatever report comes next.
+    if (!scan_held) {
+        scan_pending = false;
+    }
+    irq_unlock(key);
+}
+
+void zmk_latency_hold_scan() {
+    unsigned int key = irq_lock();
+    scan_held = true;
+    irq_unlock(key);
+}
+
+void zmk_latency_release_scan() {
+    unsigned int key = irq_lock();
+    scan_held = false;
+    scan_pending = false;
+    irq_unlock(key);
+}
+
+bool zmk_latency_claim_scan(uint32_t *scan_time) {
+    unsigned int key = irq_lock();
+    bool claimed = scan_pending;
+    if (claimed) {
+        *scan_time = pending_scan_time;
+        scan_pending = false;
+    }
+    irq_unlock(key);
+    return claimed;
+}
+
+static uint8_t bucket_for(uint32_t us) {
+    if (us < 2) {
+        return 0;
+    }
+    return MIN(31 - __builtin_clz(us), ZMK_LATENCY_BUCKETS - 1);
+}
+
+static void log_stats(const struct zmk_latency_stats *s) {
+    uint32_t p99_bucket = 0;
+    uint32_t seen = 0;
+    while (p99_bucket < ZMK_LATENCY_BUCKETS - 1) {
+        seen += s->buckets[p99_bucket];
+        if (seen * 100 >= s->count * 99) {
+            break;
+        }
+        p99_bucket++;
+    }
+
+    LOG_INF("Report latency over %d reports: min %d us, avg %d us, p99 < %d us, max %d us",
+            s->count, s->min_us, (uint32_t)(s->total_us / s->count), 1 << (p99_bucket + 1),
+            s->max_us);
+}
+
+void zmk_latency_report_delivered(uint32_t scan_time) {
+    uint32_t us = k_cyc_to_us_floor32(k_cycle_get_32() - scan_time);
+    struct zmk_latency_stats snapshot;
+    bool log = false;
+
+    LOG_DBG("Report delivered %d us after scan", us);
+
+    unsigned int key = irq_lock();
+    stats.count++;
+    stats.min_us = MIN(stats.min_us, us);
+    stats.max_us = MAX(stats.max_us, us);
+    stats.total_us += us;
+    stats.buckets[bucket_for(us)]++;
+    if (CONFIG_ZMK_LATENCY_STATS_LOG_INTERVAL > 0 &&
+        stats.count % CONFIG_ZMK_LATENCY_STATS_LOG_INTERVAL == 0) {
+        snapshot = stats;
+        log = true;
+    }
+    irq_unlock(key);
+
+    if (log) {
+        log_stats(&snapshot);
+    }
+}
+
+void zmk_latency_get_stats(struct zmk_latency_stats *dest) {
+    unsigned int key = irq_lock();
+    *dest = stats;
+    irq_unlock(key);
+}
+
+void zmk_latency_reset() {
+    unsigned int key = irq_lock();
+    stats = (struct zmk_latency_stats){.min_us = UINT32_MAX};
+    scan_pending = false;
+    scan_held = false;
+    irq_unlock(key);
+}
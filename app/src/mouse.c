@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) 2020 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <kernel.h>
+#include <logging/log.h>
+
+LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
+
+#include <zmk/event-manager.h>
+#include <zmk/events/mouse-move-state-changed.h>
+#include <zmk/endpoints.h>
+#include <zmk/hid.h>
+#include <zmk/mouse.h>
+
+// Acceleration curves are evaluated in Q16 fixed point.
+#define CURVE_SHIFT 16
+#define CURVE_ONE (1 << CURVE_SHIFT)
+
+// Speeds are units per second and ticks are measured in ms, so movement is integrated in
+// thousandths of a unit to keep sub-unit movement between ticks.
+#define MILLI_UNITS 1000
+
+struct mouse_motion {
+    // Sum of the max speeds of all held keys, so e.g. up + left moves diagonally.
+    struct vector2d max_speed;
+    struct zmk_mouse_move_config config;
+    uint8_t held;
+    int64_t start_time;
+    // Integrated movement not yet converted into whole units.
+    int32_t remainder_x;
+    int32_t remainder_y;
+    // Whole units not yet delivered to the host.
+    int32_t pending_x;
+    int32_t pending_y;
+};
+
+static struct mouse_motion move;
+static struct mouse_motion scroll;
+
+static bool tick_running;
+static int64_t last_tick;
+
+static uint32_t speed_factor(const struct mouse_motion *motion, int64_t now) {
+    uint32_t time_to_max = motion->config.time_to_max_speed_ms;
+    int64_t elapsed = now - motion->start_time;
+
+    if (time_to_max == 0 || elapsed >= time_to_max) {
+        return CURVE_ONE;
+    }
+
+    uint32_t progress = (uint32_t)((elapsed << CURVE_SHIFT) / time_to_max);
+    uint32_t factor = CURVE_ONE;
+    for (int i = 0; i < motion->config.acceleration_exponent; i++) {
+        factor = ((uint64_t)factor * progress) >> CURVE_SHIFT;
+    }
+    return factor;
+}
+
+static int32_t integrate_axis(int16_t max_speed, uint32_t factor, int32_t elapsed_ms,
+                              int32_t *remainder) {
+    *remainder += ((int64_t)max_speed * factor * elapsed_ms) >> CURVE_SHIFT;
+    int32_t units = *remainder / MILLI_UNITS;
+    *remainder -= units * MILLI_UNITS;
+    return units;
+}
+
+static void integrate(struct mouse_motion *motion, int64_t now, int32_t elapsed_ms) {
+    if (motion->held == 0) {
+        return;
+    }
+
+    uint32_t factor = speed_factor(motion, now);
+    motion->pending_x +=
+        integrate_axis(motion->max_speed.x, factor, elapsed_ms, &motion->remainder_x);
+    motion->pending_y +=
+        integrate_axis(motion->max_speed.y, factor, elapsed_ms, &motion->remainder_y);
+}
+
+static inline int8_t clamp_report_value(int32_t value) { return CLAMP(value, -127, 127); }
+
+static inline bool has_pending(const struct mouse_motion *motion) {
+    return motion->pending_x != 0 || motion->pending_y != 0;
+}
+
+static void consume_pending(struct mouse_motion *motion, int8_t x, int8_t y) {
+    motion->pending_x -= x;
+    motion->pending_y -= y;
+}
+
+static void clear_pending(struct mouse_motion *motion) {
+    motion->pending_x = 0;
+    motion->pending_y = 0;
+}
+
+static void mouse_tick_stop();
+
+static void mouse_tick_work_handler(struct k_work *work) {
+    int64_t now = k_uptime_get();
+    int32_t elapsed_ms = now - last_tick;
+    last_tick = now;
+
+    integrate(&move, now, elapsed_ms);
+    integrate(&scroll, now, elapsed_ms);
+
+    if (!has_pending(&move) && !has_pending(&scroll)) {
+        if (move.held == 0 && scroll.held == 0) {
+            mouse_tick_stop();
+        }
+        return;
+    }
+
+    int8_t x = clamp_report_value(move.pending_x);
+    int8_t y = clamp_report_value(move.pending_y);
+    int8_t scroll_x = clamp_report_value(scroll.pending_x);
+    int8_t scroll_y = clamp_report_value(scroll.pending_y);
+
+    zmk_hid_mouse_movement_set(x, y);
+    zmk_hid_mouse_scroll_set(scroll_x, scroll_y);
+    int err = zmk_endpoints_send_mouse_report();
+    // Movement is relative, so it must not be repeated by the next button report.
+    zmk_hid_mouse_movement_set(0, 0);
+    zmk_hid_mouse_scroll_set(0, 0);
+
+    switch (err) {
+    case 0:
+        consume_pending(&move, x, y);
+        consume_pending(&scroll, scroll_x, scroll_y);
+        break;
+    case -ENOMEM:
+    case -EBUSY:
+    case -EAGAIN:
+        // The transport is saturated. Keep the movement and send it combined with the next
+        // tick, instead of queueing up more reports than the link can carry.
+        LOG_DBG("Mouse report deferred (err %d)", err);
+        break;
+    default:
+        clear_pending(&move);
+        clear_pending(&scroll);
+        break;
+    }
+}
+
+K_WORK_DEFINE(mouse_tick_work, mouse_tick_work_handler);
+
+static void mouse_tick_expiry_function(struct k_timer *timer) { k_work_submit(&mouse_tick_work); }
+
+K_TIMER_DEFINE(mouse_tick_timer, mouse_tick_expiry_function, NULL);
+
+static void mouse_tick_start(int64_t timestamp) {
+    if (tick_running) {
+        return;
+    }
+
+    tick_running = true;
+    last_tick = timestamp;
+    k_timer_start(&mouse_tick_timer, K_MSEC(CONFIG_ZMK_MOUSE_TICK_DURATION),
+                  K_MSEC(CONFIG_ZMK_MOUSE_TICK_DURATION));
+}
+
+static void mouse_tick_stop() {
+    tick_running = false;
+    k_timer_stop(&mouse_tick_timer);
+}
+
+static void mouse_motion_pressed(struct mouse_motion *motion,
+                                 const struct mouse_move_state_changed *ev) {
+    if (motion->held == 0) {
+        motion->start_time = ev->timestamp;
+        motion->remainder_x = 0;
+        motion->remainder_y = 0;
+    }
+    motion->held++;
+    motion->max_speed.x += ev->max_speed.x;
+    motion->max_speed.y += ev->max_speed.y;
+    motion->config = ev->config;
+
+    mouse_tick_start(ev->timestamp);
+}
+
+static void mouse_motion_released(struct mouse_motion *motion,
+                                  const struct mouse_move_state_changed *ev) {
+    if (motion->held == 0) {
+        LOG_ERR("Mouse movement released more often than pressed");
+        return;
+    }
+    motion->held--;
+    motion->max_speed.x -= ev->max_speed.x;
+    motion->max_speed.y -= ev->max_speed.y;
+
+    if (motion->held == 0) {
+        motion->max_speed.x = 0;
+        motion->max_speed.y = 0;
+    }
+    // The tick stops itself once all pending movement has been sent.
+}
+
+static int mouse_listener(const struct zmk_event_header *eh) {
+    if (is_mouse_move_state_changed(eh)) {
+        const struct mouse_move_state_changed *ev = cast_mouse_move_state_changed(eh);
+        struct mouse_motion *motion = ev->scroll ? &scroll : &move;
+        LOG_DBG("%s x %d y %d state %d", ev->scroll ? "scroll" : "move", ev->max_speed.x,
+                ev->max_speed.y, ev->state);
+        if (ev->state) {
+            mouse_motion_pressed(motion, ev);
+        } else {
+            mouse_motion_released(motion, ev);
+        }
+    }
+    return 0;
+}
+
+ZMK_LISTENER(mouse_listener, mouse_listener);
+ZMK_SUBSCRIPTION(mouse_listener, mouse_move_state_changed);
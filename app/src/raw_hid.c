@@ -0,0 +1,407 @@
+/*
+ * Copyright (c) 2020 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <kernel.h>
+#include <device.h>
+#include <sys/byteorder.h>
+#include <logging/log.h>
+
+LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
+
+#include <zmk/raw_hid.h>
+#include <zmk/hid.h>
+#include <zmk/hog.h>
+#include <zmk/ble.h>
+#include <zmk/ble/link.h>
+#include <zmk/usb.h>
+#include <zmk/keymap.h>
+#include <zmk/matrix.h>
+#include <zmk/latency.h>
+#include <zmk/event-manager.h>
+#include <zmk/events/position-state-changed.h>
+#if IS_ENABLED(CONFIG_ZMK_RAW_HID_TRACE_KEYCODES)
+#include <zmk/events/keycode-state-changed.h>
+#endif
+#include <zmk/events/layer-state-changed.h>
+
+#define FRAME_COMMAND 0
+#define FRAME_TAG 1
+#define FRAME_STATUS 2
+#define REQUEST_ARGS 2
+#define RESPONSE_PAYLOAD 3
+
+#define RESPONSE_PAYLOAD_SIZE (ZMK_HID_RAW_REPORT_SIZE - RESPONSE_PAYLOAD)
+
+// Requests arrive from the USB and BLE stacks, but are handled on the system work queue, the
+// same thread that processes key events, so they never race with the keymap.
+struct raw_hid_request {
+    uint8_t endpoint;
+    // Referenced while the request waits, so the response can go back to the same host.
+    struct bt_conn *conn;
+    uint8_t data[ZMK_HID_RAW_REPORT_SIZE];
+};
+
+K_MSGQ_DEFINE(raw_hid_msgq, sizeof(struct raw_hid_request), CONFIG_ZMK_RAW_HID_REQUEST_QUEUE_SIZE,
+              4);
+
+struct trace_entry {
+    uint32_t timestamp;
+    uint8_t type;
+    uint8_t state;
+    uint8_t usage_page;
+    uint16_t value;
+};
+
+#define TRACE_ENTRY_SIZE 9
+
+static struct trace_entry trace[CONFIG_ZMK_RAW_HID_TRACE_SIZE];
+static uint16_t trace_head = 0;
+static uint16_t trace_len = 0;
+static uint8_t trace_dropped = 0;
+
+static void trace_record(uint8_t type, bool state, uint8_t usage_page, uint16_t value,
+                         int64_t timestamp) {
+    unsigned int key = irq_lock();
+    if (trace_len == CONFIG_ZMK_RAW_HID_TRACE_SIZE) {
+        // Keep the newest entries, the host only learns how many were lost.
+        trace_head = (trace_head + 1) % CONFIG_ZMK_RAW_HID_TRACE_SIZE;
+        trace_len--;
+        trace_dropped = MIN(trace_dropped + 1, UINT8_MAX);
+    }
+    trace[(trace_head + trace_len++) % CONFIG_ZMK_RAW_HID_TRACE_SIZE] = (struct trace_entry){
+        .timestamp = (uint32_t)timestamp,
+        .type = type,
+        .state = state,
+        .usage_page = usage_page,
+        .value = value,
+    };
+    irq_unlock(key);
+}
+
+static uint8_t handle_get_version(const uint8_t *args, uint8_t *payload, uint8_t *len) {
+    payload[0] = ZMK_RAW_HID_PROTOCOL_VERSION;
+    payload[1] = ZMK_HID_RAW_REPORT_SIZE;
+    payload[2] = zmk_keymap_layer_count();
+    sys_put_le16(ZMK_KEYMAP_LEN, &payload[3]);
+    *len = 5;
+    return ZMK_RAW_HID_STATUS_OK;
+}
+
+#if IS_ENABLED(CONFIG_ZMK_LATENCY_STATS)
+
+static uint8_t handle_get_latency(const uint8_t *args, uint8_t *payload, uint8_t *len) {
+    struct zmk_latency_stats stats;
+    zmk_latency_get_stats(&stats);
+
+    sys_put_le32(stats.count, &payload[0]);
+    sys_put_le32(stats.count ? stats.min_us : 0, &payload[4]);
+    sys_put_le32(stats.max_us, &payload[8]);
+    sys_put_le32(stats.count ? (uint32_t)(stats.total_us / stats.count) : 0, &payload[12]);
+    *len = 16;
+    return ZMK_RAW_HID_STATUS_OK;
+}
+
+#define HISTOGRAM_BUCKETS_PER_FRAME ((RESPONSE_PAYLOAD_SIZE - 2) / sizeof(uint32_t))
+
+static uint8_t handle_get_latency_histogram(const uint8_t *args, uint8_t *payload, uint8_t *len) {
+    uint8_t first = args[0];
+    if (first >= ZMK_LATENCY_BUCKETS) {
+        return ZMK_RAW_HID_STATUS_INVALID_ARGUMENT;
+    }
+
+    struct zmk_latency_stats stats;
+    zmk_latency_get_stats(&stats);
+
+    uint8_t count = MIN(ZMK_LATENCY_BUCKETS - first, HISTOGRAM_BUCKETS_PER_FRAME);
+    payload[0] = first;
+    payload[1] = count;
+    for (int i = 0; i < count; i++) {
+        sys_put_le32(stats.buckets[first + i], &payload[2 + i * sizeof(uint32_t)]);
+    }
+    *len = 2 + count * sizeof(uint32_t);
+    return ZMK_RAW_HID_STATUS_OK;
+}
+
+static uint8_t handle_reset_latency(const uint8_t *args, uint8_t *payload, uint8_t *len) {
+    zmk_latency_reset();
+    return ZMK_RAW_HID_STATUS_OK;
+}
+
+#endif /* IS_ENABLED(CONFIG_ZMK_LATENCY_STATS) */
+
+#define TRACE_ENTRIES_PER_FRAME ((RESPONSE_PAYLOAD_SIZE - 2) / TRACE_ENTRY_SIZE)
+
+static uint8_t handle_read_trace(const uint8_t *args, uint8_t *payload, uint8_t *len) {
+    unsigned int key = irq_lock();
+    uint8_t count = MIN(trace_len, TRACE_ENTRIES_PER_FRAME);
+    payload[0] = trace_dropped;
+    payload[1] = count;
+    for (int i = 0; i < count; i++) {
+        const struct trace_entry *entry = &trace[(trace_head + i) % CONFIG_ZMK_RAW_HID_TRACE_SIZE];
+        uint8_t *out = &payload[2 + i * TRACE_ENTRY_SIZE];
+        sys_put_le32(entry->timestamp, &out[0]);
+        out[4] = entry->type;
+        out[5] = entry->state;
+        out[6] = entry->usage_page;
+        sys_put_le16(entry->value, &out[7]);
+    }
+    trace_head = (trace_head + count) % CONFIG_ZMK_RAW_HID_TRACE_SIZE;
+    trace_len -= count;
+    trace_dropped = 0;
+    irq_unlock(key);
+
+    *len = 2 + count * TRACE_ENTRY_SIZE;
+    return ZMK_RAW_HID_STATUS_OK;
+}
+
+static uint8_t handle_get_binding(const uint8_t *args, uint8_t *payload, uint8_t *len) {
+    struct zmk_behavior_binding binding;
+    if (zmk_keymap_get_binding(args[0], sys_get_le16(&args[1]), &binding)) {
+        return ZMK_RAW_HID_STATUS_INVALID_ARGUMENT;
+    }
+
+    size_t name_len = strlen(binding.behavior_dev);
+    if (name_len + 1 > RESPONSE_PAYLOAD_SIZE - 8) {
+        return ZMK_RAW_HID_STATUS_OVERFLOW;
+    }
+
+    sys_put_le32(binding.param1, &payload[0]);
+    sys_put_le32(binding.param2, &payload[4]);
+    memcpy(&payload[8], binding.behavior_dev, name_len + 1);
+    *len = 8 + name_len + 1;
+    return ZMK_RAW_HID_STATUS_OK;
+}
+
+#define SET_BINDING_NAME_OFFSET 11
+#define SET_BINDING_NAME_SIZE (ZMK_HID_RAW_REPORT_SIZE - REQUEST_ARGS - SET_BINDING_NAME_OFFSET)
+
+static uint8_t handle_set_binding(const uint8_t *args, uint8_t *payload, uint8_t *len) {
+    char name[SET_BINDING_NAME_SIZE];
+    memcpy(name, &args[SET_BINDING_NAME_OFFSET], sizeof(name));
+    if (strnlen(name, sizeof(name)) == sizeof(name)) {
+        return ZMK_RAW_HID_STATUS_INVALID_ARGUMENT;
+    }
+
+    struct zmk_behavior_binding binding = {
+        .behavior_dev = name,
+        .param1 = sys_get_le32(&args[3]),
+        .param2 = sys_get_le32(&args[7]),
+    };
+    if (zmk_keymap_set_binding(args[0], sys_get_le16(&args[1]), &binding)) {
+        return ZMK_RAW_HID_STATUS_INVALID_ARGUMENT;
+    }
+    return ZMK_RAW_HID_STATUS_OK;
+}
+
+#if IS_ENABLED(CONFIG_ZMK_BLE)
+
+#define BLE_ACTIVE_PROFILE 0xFF
+
+static uint8_t requested_profile_conn(const uint8_t *args, uint8_t *profile,
+                                      struct bt_conn **conn) {
+    *profile = args[0] == BLE_ACTIVE_PROFILE ? zmk_ble_active_profile_index() : args[0];
+    if (*profile >= zmk_ble_profile_count()) {
+        return ZMK_RAW_HID_STATUS_INVALID_ARGUMENT;
+    }
+
+    *conn = zmk_ble_profile_conn(*profile);
+    return *conn ? ZMK_RAW_HID_STATUS_OK : ZMK_RAW_HID_STATUS_NOT_CONNECTED;
+}
+
+static uint8_t handle_get_ble_link(const uint8_t *args, uint8_t *payload, uint8_t *len) {
+    struct bt_conn *conn;
+    struct zmk_ble_link_stats stats;
+
+    uint8_t status = requested_profile_conn(args, &payload[0], &conn);
+    if (status != ZMK_RAW_HID_STATUS_OK) {
+        return status;
+    }
+    if (zmk_ble_link_get_stats(conn, &stats)) {
+        return ZMK_RAW_HID_STATUS_NOT_CONNECTED;
+    }
+
+    sys_put_le16(stats.interval, &payload[1]);
+    sys_put_le16(stats.latency, &payload[3]);
+    sys_put_le16(stats.timeout, &payload[5]);
+    payload[7] = stats.tx_phy;
+    payload[8] = stats.rx_phy;
+    sys_put_le16(stats.tx_max_len, &payload[9]);
+    sys_put_le16(stats.rx_max_len, &payload[11]);
+    sys_put_le16(stats.param_updates, &payload[13]);
+    sys_put_le16(stats.phy_updates, &payload[15]);
+    *len = 17;
+    return ZMK_RAW_HID_STATUS_OK;
+}
+
+static uint8_t handle_get_ble_notify_stats(const uint8_t *args, uint8_t *payload, uint8_t *len) {
+    struct bt_conn *conn;
+    struct zmk_hog_stats stats;
+
+    uint8_t status = requested_profile_conn(args, &payload[0], &conn);
+    if (status != ZMK_RAW_HID_STATUS_OK) {
+        return status;
+    }
+    if (zmk_hog_get_stats(conn, &stats)) {
+        return ZMK_RAW_HID_STATUS_NOT_CONNECTED;
+    }
+
+    sys_put_le32(stats.notify_sent, &payload[1]);
+    sys_put_le32(stats.notify_failed, &payload[5]);
+    payload[9] = stats.queue_depth;
+    payload[10] = stats.max_queue_depth;
+    sys_put_le32(stats.latency_count, &payload[11]);
+    sys_put_le32(stats.latency_count ? stats.latency_min_us : 0, &payload[15]);
+    sys_put_le32(stats.latency_max_us, &payload[19]);
+    sys_put_le32(stats.latency_count ? (uint32_t)(stats.latency_total_us / stats.latency_count) : 0,
+                 &payload[23]);
+    *len = 27;
+    return ZMK_RAW_HID_STATUS_OK;
+}
+
+#endif /* IS_ENABLED(CONFIG_ZMK_BLE) */
+
+static uint8_t handle_request(const uint8_t *request, uint8_t *payload, uint8_t *len) {
+    const uint8_t *args = &request[REQUEST_ARGS];
+
+    switch (request[FRAME_COMMAND]) {
+    case ZMK_RAW_HID_CMD_GET_VERSION:
+        return handle_get_version(args, payload, len);
+#if IS_ENABLED(CONFIG_ZMK_LATENCY_STATS)
+    case ZMK_RAW_HID_CMD_GET_LATENCY:
+        return handle_get_latency(args, payload, len);
+    case ZMK_RAW_HID_CMD_GET_LATENCY_HISTOGRAM:
+        return handle_get_latency_histogram(args, payload, len);
+    case ZMK_RAW_HID_CMD_RESET_LATENCY:
+        return handle_reset_latency(args, payload, len);
+#else
+    case ZMK_RAW_HID_CMD_GET_LATENCY:
+    case ZMK_RAW_HID_CMD_GET_LATENCY_HISTOGRAM:
+    case ZMK_RAW_HID_CMD_RESET_LATENCY:
+        return ZMK_RAW_HID_STATUS_NOT_SUPPORTED;
+#endif /* IS_ENABLED(CONFIG_ZMK_LATENCY_STATS) */
+    case ZMK_RAW_HID_CMD_READ_TRACE:
+        return handle_read_trace(args, payload, len);
+    case ZMK_RAW_HID_CMD_GET_BINDING:
+        return handle_get_binding(args, payload, len);
+    case ZMK_RAW_HID_CMD_SET_BINDING:
+        return handle_set_binding(args, payload, len);
+#if IS_ENABLED(CONFIG_ZMK_BLE)
+    case ZMK_RAW_HID_CMD_GET_BLE_LINK:
+        return handle_get_ble_link(args, payload, len);
+    case ZMK_RAW_HID_CMD_GET_BLE_NOTIFY_STATS:
+        return handle_get_ble_notify_stats(args, payload, len);
+#else
+    case ZMK_RAW_HID_CMD_GET_BLE_LINK:
+    case ZMK_RAW_HID_CMD_GET_BLE_NOTIFY_STATS:
+        return ZMK_RAW_HID_STATUS_NOT_SUPPORTED;
+#endif /* IS_ENABLED(CONFIG_ZMK_BLE) */
+    default:
+        return ZMK_RAW_HID_STATUS_UNKNOWN_COMMAND;
+    }
+}
+
+static int send_response(const struct raw_hid_request *request,
+                         const struct zmk_hid_raw_report_body *body) {
+    switch (request->endpoint) {
+#if IS_ENABLED(CONFIG_ZMK_USB)
+    case ZMK_ENDPOINT_USB: {
+        static struct zmk_hid_raw_report report = {.report_id = ZMK_HID_REPORT_ID_RAW};
+        report.body = *body;
+        return zmk_usb_hid_send_report((uint8_t *)&report, sizeof(report));
+    }
+#endif /* IS_ENABLED(CONFIG_ZMK_USB) */
+
+#if IS_ENABLED(CONFIG_ZMK_BLE)
+    case ZMK_ENDPOINT_BLE:
+        return zmk_hog_send_raw_report(request->conn, body);
+#endif /* IS_ENABLED(CONFIG_ZMK_BLE) */
+
+    default:
+        LOG_ERR("Unsupported endpoint %d", request->endpoint);
+        return -ENOTSUP;
+    }
+}
+
+static void release_request(struct raw_hid_request *request) {
+#if IS_ENABLED(CONFIG_ZMK_BLE)
+    if (request->conn != NULL) {
+        bt_conn_unref(request->conn);
+        request->conn = NULL;
+    }
+#endif /* IS_ENABLED(CONFIG_ZMK_BLE) */
+}
+
+static void raw_hid_work_handler(struct k_work *work) {
+    struct raw_hid_request request;
+
+    while (k_msgq_get(&raw_hid_msgq, &request, K_NO_WAIT) == 0) {
+        struct zmk_hid_raw_report_body response = {0};
+        uint8_t len = 0;
+
+        response.data[FRAME_COMMAND] = request.data[FRAME_COMMAND];
+        response.data[FRAME_TAG] = request.data[FRAME_TAG];
+        response.data[FRAME_STATUS] =
+            handle_request(request.data, &response.data[RESPONSE_PAYLOAD], &len);
+        LOG_DBG("Raw HID command 0x%02X status %d", request.data[FRAME_COMMAND],
+                response.data[FRAME_STATUS]);
+
+        int err = send_response(&request, &response);
+        if (err) {
+            LOG_ERR("Failed to send raw HID response (err %d)", err);
+        }
+        release_request(&request);
+    }
+}
+
+K_WORK_DEFINE(raw_hid_work, raw_hid_work_handler);
+
+int zmk_raw_hid_receive(enum zmk_endpoint endpoint, struct bt_conn *conn, const uint8_t *data,
+                        size_t len) {
+    struct raw_hid_request request = {.endpoint = endpoint};
+
+    if (len != ZMK_HID_RAW_REPORT_SIZE) {
+        return -EINVAL;
+    }
+    memcpy(request.data, data, len);
+#if IS_ENABLED(CONFIG_ZMK_BLE)
+    request.conn = conn ? bt_conn_ref(conn) : NULL;
+#endif /* IS_ENABLED(CONFIG_ZMK_BLE) */
+
+    int err = k_msgq_put(&raw_hid_msgq, &request, K_NO_WAIT);
+    if (err) {
+        LOG_WRN("Raw HID request queue is full, dropping command 0x%02X", data[FRAME_COMMAND]);
+        release_request(&request);
+        return err;
+    }
+
+    k_work_submit(&raw_hid_work);
+    return 0;
+}
+
+static int raw_hid_trace_listener(const struct zmk_event_header *eh) {
+    if (is_position_state_changed(eh)) {
+        const struct position_state_changed *ev = cast_position_state_changed(eh);
+        trace_record(ZMK_RAW_HID_TRACE_POSITION, ev->state, 0, ev->position, ev->timestamp);
+#if IS_ENABLED(CONFIG_ZMK_RAW_HID_TRACE_KEYCODES)
+    } else if (is_keycode_state_changed(eh)) {
+        // Keycodes reveal what was typed, so they're only recorded if explicitly enabled.
+        const struct keycode_state_changed *ev = cast_keycode_state_changed(eh);
+        trace_record(ZMK_RAW_HID_TRACE_KEYCODE, ev->state, ev->usage_page, ev->keycode,
+                     ev->timestamp);
+#endif /* IS_ENABLED(CONFIG_ZMK_RAW_HID_TRACE_KEYCODES) */
+    } else if (is_layer_state_changed(eh)) {
+        const struct layer_state_changed *ev = cast_layer_state_changed(eh);
+        trace_record(ZMK_RAW_HID_TRACE_LAYER, ev->state, 0, ev->layer, ev->timestamp);
+    }
+    return 0;
+}
+
+ZMK_LISTENER(raw_hid_trace_listener, raw_hid_trace_listener);
+ZMK_SUBSCRIPTION(raw_hid_trace_listener, position_state_changed);
+#if IS_ENABLED(CONFIG_ZMK_RAW_HID_TRACE_KEYCODES)
+ZMK_SUBSCRIPTION(raw_hid_trace_listener, keycode_state_changed);
+#endif
+ZMK_SUBSCRIPTION(raw_hid_trace_listener, layer_state_changed);
@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2020 The ZMK Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <device.h>
+#include <init.h>
+#include <kernel.h>
+#include <string.h>
+#include <settings/settings.h>
+
+#include <logging/log.h>
+
+LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
+
+#include <zmk/settings.h>
+#include <zmk/activity.h>
+#include <zmk/event-manager.h>
+#include <zmk/events/activity-state-changed.h>
+
+// Every change restarts the save debounce, but a key waits at most ZMK_SETTINGS_SAVE_MAX_DELAY
+// after it first changed, so constant changes can't hold back a save forever. All dirty keys are
+// written together, so toggling several settings in a row costs one burst of flash writes instead
+// of one per subsystem, and toggling a setting back and forth costs none.
+
+struct settings_cache_entry {
+    const char *name;
+    bool dirty;
+    bool written;
+    uint8_t len;
+    uint8_t value[ZMK_SETTINGS_MAX_VALUE_SIZE];
+    // The value last written to flash, valid if written is set.
+    uint8_t written_len;
+    uint8_t written_value[ZMK_SETTINGS_MAX_VALUE_SIZE];
+};
+
+static struct settings_cache_entry entries[CONFIG_ZMK_SETTINGS_CACHE_SIZE];
+
+// Uptime at which the oldest unsaved change was queued.
+static int64_t first_dirty_time;
+static bool any_dirty = false;
+
+static struct k_delayed_work flush_work;
+
+static struct settings_cache_entry *find_entry(const char *name) {
+    struct settings_cache_entry *free_entry = NULL;
+
+    for (int i = 0; i < ARRAY_SIZE(entries); i++) {
+        if (entries[i].name == NULL) {
+            if (free_entry == NULL) {
+                free_entry = &entries[i];
+            }
+        } else if (strcmp(entries[i].name, name) == 0) {
+            return &entries[i];
+        }
+    }
+
+    if (free_entry != NULL) {
+        free_entry->name = name;
+    }
+    return free_entry;
+}
+
+static inline bool matches_written(const struct settings_cache_entry *entry) {
+    return entry->written && entry->written_len == entry->len &&
+           memcmp(entry->written_value, entry->value, entry->len) == 0;
+}
+
+int zmk_settings_queue_save(const char *name, const void *value, size_t len) {
+    if (len > ZMK_SETTINGS_MAX_VALUE_SIZE) {
+        LOG_ERR("Setting %s is too large to queue", name);
+        return -EINVAL;
+    }
+
+    unsigned int key = irq_lock();
+    struct settings_cache_entry *entry = find_entry(name);
+    if (entry == NULL) {
+        irq_unlock(key);
+        LOG_WRN("Settings cache is full, saving %s right away", name);
+        return settings_save_one(name, value, len);
+    }
+
+    memcpy(entry->value, value, len);
+    entry->len = len;
+    entry->dirty = !matches_written(entry);
+    if (entry->dirty && !any_dirty) {
+        any_dirty = true;
+        first_dirty_time = k_uptime_get();
+    }
+
+    int64_t max_delay = first_dirty_time + CONFIG_ZMK_SETTINGS_SAVE_MAX_DELAY - k_uptime_get();
+    irq_unlock(key);
+
+    k_delayed_work_cancel(&flush_work);
+    return k_delayed_work_submit(
+        &flush_work, K_MSEC(CLAMP(max_delay, 0, CONFIG_ZMK_SETTINGS_SAVE_DEBOUNCE)));
+}
+
+void zmk_settings_flush() {
+    int saved = 0;
+
+    k_delayed_work_cancel(&flush_work);
+
+    for (int i = 0; i < ARRAY_SIZE(entries); i++) {
+        struct settings_cache_entry *entry = &entries[i];
+        uint8_t value[ZMK_SETTINGS_MAX_VALUE_SIZE];
+
+        unsigned int key = irq_lock();
+        if (entry->name == NULL || !entry->dirty) {
+            irq_unlock(key);
+            continue;
+        }
+        uint8_t len = entry->len;
+        memcpy(value, entry->value, len);
+        entry->dirty = false;
+        irq_unlock(key);
+
+        int err = settings_save_one(entry->name, value, len);
+        if (err) {
+            // Left dirty, so the next flush tries again.
+            LOG_ERR("Failed to save %s (err %d)", entry->name, err);
+            key = irq_lock();
+            entry->dirty = true;
+            irq_unlock(key);
+            continue;
+        }
+
+        key = irq_lock();
+        entry->written = true;
+        entry->written_len = len;
+        memcpy(entry->written_value, value, len);
+        // A change queued while writing is still dirty, unless it went back to the written value.
+        entry->dirty = entry->dirty && !matches_written(entry);
+        irq_unlock(key);
+        saved++;
+    }
+
+    unsigned int key = irq_lock();
+    any_dirty = false;
+    for (int i = 0; i < ARRAY_SIZE(entries); i++) {
+        any_dirty = any_dirty || entries[i].dirty;
+    }
+    irq_unlock(key);
+
+    LOG_DBG("Saved %d settings", saved);
+}
+
+static void flush_work_handler(struct k_work *work) { zmk_settings_flush(); }
+
+#if IS_ENABLED(CONFIG_ZMK_SETTINGS_SAVE_ON_SLEEP)
+// The keyboard powers off when it goes to sleep, which would lose the queued changes.
+static int settings_sleep_listener(const struct zmk_event_header *eh) {
+    if (cast_activity_state_changed(eh)->state == ZMK_ACTIVITY_SLEEP) {
+        zmk_settings_flush();
+    }
+    return 0;
+}
+
+ZMK_LISTENER(settings, settings_sleep_listener);
+ZMK_SUBSCRIPTION(settings, activity_state_changed);
+#endif /* IS_ENABLED(CONFIG_ZMK_SETTINGS_SAVE_ON_SLEEP) */
+
+static int settings_cache_init(const struct device *_arg) {
+    k_delayed_work_init(&flush_work, flush_work_handler);
+    return 0;
+}
+
+// Runs before the application level, where the subsystems that queue saves are initialized.
+SYS_INIT(settings_cache_init, POST_KERNEL, CONFIG_KERNEL_INIT_PRIORITY_DEFAULT);
@@ -10,8 +10,12 @@
 #include <usb/usb_device.h>
 #include <usb/class/usb_hid.h>
 
+#include <zmk/endpoints.h>
 #include <zmk/hid.h>
+#include <zmk/hid_indicators.h>
 #include <zmk/keymap.h>
+#include <zmk/latency.h>
+#include <zmk/raw_hid.h>
 #include <zmk/event-manager.h>
 #include <zmk/events/usb-conn-state-changed.h>
 
@@ -23,15 +27,331 @@ static enum usb_dc_status_code usb_status = USB_DC_UNKNOWN;
 
 static const struct device *hid_dev;
 
-static K_SEM_DEFINE(hid_sem, 1, 1);
+static uint8_t hid_protocol = HID_PROTOCOL_REPORT;
 
-static void in_ready_cb(const struct device *dev) { k_sem_give(&hid_sem); }
+// Reports sent while the interrupt endpoint is busy are queued here and written from the
+// int_in_ready callback, so sending never blocks the caller.
+#define USB_HID_KEYS_REPORT_SIZE                                                                   \
+    MAX(sizeof(struct zmk_hid_keyboard_report), sizeof(struct zmk_hid_consumer_report))
+
+#ifdef CONFIG_ZMK_MOUSE
+#define USB_HID_STATE_REPORT_SIZE                                                                  \
+    MAX(USB_HID_KEYS_REPORT_SIZE, sizeof(struct zmk_hid_mouse_report))
+#else
+#define USB_HID_STATE_REPORT_SIZE USB_HID_KEYS_REPORT_SIZE
+#endif
+
+#ifdef CONFIG_ZMK_RAW_HID
+#define USB_HID_MAX_REPORT_SIZE MAX(USB_HID_STATE_REPORT_SIZE, sizeof(struct zmk_hid_raw_report))
+#else
+#define USB_HID_MAX_REPORT_SIZE USB_HID_STATE_REPORT_SIZE
+#endif
+
+#define USB_HID_MAX_REPORT_ID 8
+
+struct usb_hid_report {
+    uint8_t len;
+    uint8_t data[USB_HID_MAX_REPORT_SIZE];
+    // Scan that caused this report, used to measure the latency once it has been delivered.
+    bool timed;
+    uint32_t scan_time;
+};
+
+static struct usb_hid_report report_queue[CONFIG_ZMK_USB_HID_REPORT_QUEUE_SIZE];
+static uint8_t report_queue_head = 0;
+static uint8_t report_queue_len = 0;
+
+// The last report handed to the endpoint for each report ID.
+static struct usb_hid_report last_written[USB_HID_MAX_REPORT_ID + 1];
+
+static bool endpoint_busy = false;
+
+// Latency timestamp of the report currently being transferred.
+static bool in_flight_timed = false;
+static uint32_t in_flight_scan_time;
+
+static inline struct usb_hid_report *queued_report(uint8_t idx) {
+    return &report_queue[(report_queue_head + idx) % CONFIG_ZMK_USB_HID_REPORT_QUEUE_SIZE];
+}
+
+// Boot protocol reports have no report ID, so they are all queued under the reserved ID 0.
+static inline uint8_t report_id(const uint8_t *report) {
+    return hid_protocol == HID_PROTOCOL_BOOT ? 0 : report[0];
+}
+
+static void store_report(struct usb_hid_report *dest, const uint8_t *report, size_t len) {
+    memcpy(dest->data, report, len);
+    dest->len = len;
+}
+
+static int write_report(const uint8_t *report, size_t len, bool timed, uint32_t scan_time) {
+    if (report_id(report) <= USB_HID_MAX_REPORT_ID) {
+        store_report(&last_written[report_id(report)], report, len);
+    }
+    in_flight_timed = timed;
+    in_flight_scan_time = scan_time;
+    return hid_int_ep_write(hid_dev, report, len, NULL);
+}
+
+// A queued report can be replaced by a newer one for the same report ID, unless that would hide
+// a change from the host.
+static bool can_supersede(const struct usb_hid_report *previous,
+                          const struct usb_hid_report *queued, const uint8_t *report, size_t len) {
+    return queued->len == len && previous->len == len &&
+           zmk_hid_report_can_supersede(previous->data, queued->data, report, len);
+}
+
+static inline bool is_mouse_report(const uint8_t *report) {
+    return IS_ENABLED(CONFIG_ZMK_MOUSE) && hid_protocol != HID_PROTOCOL_BOOT &&
+           report[0] == ZMK_HID_REPORT_ID_MOUSE;
+}
+
+// Mouse reports carry movement deltas and raw HID frames are messages, so neither is state that a
+// newer report can replace.
+static inline bool is_state_report(const uint8_t *report) {
+    return hid_protocol == HID_PROTOCOL_BOOT ||
+           (report[0] != ZMK_HID_REPORT_ID_RAW && report[0] != ZMK_HID_REPORT_ID_MOUSE);
+}
+
+#ifdef CONFIG_ZMK_MOUSE
+// Adds a mouse report to the newest queued one instead of queueing it, if that keeps every change.
+// If the queue is full they're combined anyway, the buttons then end up in their latest state.
+static bool merge_mouse_report(struct usb_hid_report *newest, const uint8_t *report, size_t len) {
+    const struct zmk_hid_mouse_report *earlier = (const struct zmk_hid_mouse_report *)newest->data;
+    struct zmk_hid_mouse_report merged = *(const struct zmk_hid_mouse_report *)report;
+
+    if (report_queue_len < CONFIG_ZMK_USB_HID_REPORT_QUEUE_SIZE &&
+        !zmk_hid_mouse_report_can_merge(&merged.body, &earlier->body)) {
+        return false;
+    }
+
+    zmk_hid_mouse_report_merge(&merged.body, &earlier->body);
+    store_report(newest, (const uint8_t *)&merged, len);
+    return true;
+}
+#else
+static inline bool merge_mouse_report(struct usb_hid_report *newest, const uint8_t *report,
+                                      size_t len) {
+    return false;
+}
+#endif /* CONFIG_ZMK_MOUSE */
+
+// Only reports carrying key state are measured, not mouse movement or raw HID responses.
+static inline bool is_key_report(const uint8_t *report) {
+    return hid_protocol == HID_PROTOCOL_BOOT || report[0] == ZMK_HID_REPORT_ID_KEYBOARD ||
+           report[0] == ZMK_HID_REPORT_ID_CONSUMER;
+}
+
+// Every report ID can keep one queued entry, so a full queue always has an entry that can give
+// way. The report IDs are numbered from 1, so the highest one is their count.
+BUILD_ASSERT(CONFIG_ZMK_USB_HID_REPORT_QUEUE_SIZE > ZMK_HID_REPORT_ID_RAW,
+             "The USB HID report queue needs room for more reports than there are report IDs");
+
+static void remove_queued_report(uint8_t idx) {
+    for (int i = idx; i < report_queue_len - 1; i++) {
+        *queued_report(i) = *queued_report(i + 1);
+    }
+    report_queue_len--;
+}
+
+// Index of the next queued entry with the same report ID as the one at idx, or -1 if there is none.
+static int next_queued_index(uint8_t idx) {
+    uint8_t id = report_id(queued_report(idx)->data);
+    for (int i = idx + 1; i < report_queue_len; i++) {
+        if (report_id(queued_report(i)->data) == id) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Frees an entry of a full queue, so a key release still fits when e.g. mouse movement or raw HID
+// frames filled it. The oldest mouse report that has a later one is added to it, otherwise the
+// oldest raw HID frame is dropped, otherwise the oldest state report that a later one with the
+// same report ID supersedes.
+static bool make_room() {
+    int raw = -1;
+    int superseded = -1;
+
+    for (int i = 0; i < report_queue_len; i++) {
+        struct usb_hid_report *entry = queued_report(i);
+        int next = next_queued_index(i);
+#ifdef CONFIG_ZMK_MOUSE
+        if (is_mouse_report(entry->data) && next >= 0) {
+            struct usb_hid_report *later = queued_report(next);
+            zmk_hid_mouse_report_merge(&((struct zmk_hid_mouse_report *)later->data)->body,
+                                       &((const struct zmk_hid_mouse_report *)entry->data)->body);
+            remove_queued_report(i);
+            return true;
+        }
+#endif /* CONFIG_ZMK_MOUSE */
+        if (!is_state_report(entry->data)) {
+            if (!is_mouse_report(entry->data) && raw < 0) {
+                raw = i;
+            }
+        } else if (next >= 0 && superseded < 0) {
+            superseded = i;
+        }
+    }
+
+    if (raw >= 0) {
+        LOG_WRN("USB HID report queue is full, dropping a raw HID frame");
+        remove_queued_report(raw);
+        return true;
+    }
+    if (superseded >= 0) {
+        // The later report carries the change now, so it keeps measuring from the older scan.
+        struct usb_hid_report *later = queued_report(next_queued_index(superseded));
+        if (queued_report(superseded)->timed && !later->timed) {
+            later->timed = true;
+            later->scan_time = queued_report(superseded)->scan_time;
+        }
+        remove_queued_report(superseded);
+        return true;
+    }
+    return false;
+}
+
+static int queue_report(const uint8_t *report, size_t len, bool timed, uint32_t scan_time) {
+    struct usb_hid_report *newest = NULL;
+    struct usb_hid_report *previous = NULL;
+
+    for (int i = report_queue_len - 1; i >= 0; i--) {
+        struct usb_hid_report *entry = queued_report(i);
+        if (report_id(entry->data) != report_id(report)) {
+            continue;
+        }
+        if (newest == NULL) {
+            newest = entry;
+        } else {
+            previous = entry;
+            break;
+        }
+    }
+
+    if (newest != NULL && is_mouse_report(report) && merge_mouse_report(newest, report, len)) {
+        return 0;
+    }
+
+    if (newest != NULL && is_state_report(report)) {
+        if (previous == NULL && report_id(report) <= USB_HID_MAX_REPORT_ID) {
+            previous = &last_written[report_id(report)];
+        }
+        // If the queue is full, keep the final state rather than dropping it, so no key gets stuck.
+        if (report_queue_len == CONFIG_ZMK_USB_HID_REPORT_QUEUE_SIZE ||
+            (previous != NULL && can_supersede(previous, newest, report, len))) {
+            store_report(newest, report, len);
+            // The replaced report's scan is the older one, so keep measuring from there.
+            if (!newest->timed) {
+                newest->timed = timed;
+                newest->scan_time = scan_time;
+            }
+            return 0;
+        }
+    }
+
+    if (report_queue_len == CONFIG_ZMK_USB_HID_REPORT_QUEUE_SIZE && !make_room()) {
+        LOG_WRN("USB HID report queue is full");
+        return -ENOMEM;
+    }
+
+    struct usb_hid_report *entry = queued_report(report_queue_len++);
+    store_report(entry, report, len);
+    entry->timed = timed;
+    entry->scan_time = scan_time;
+    return 0;
+}
+
+static void reset_report_queue() {
+    unsigned int key = irq_lock();
+    report_queue_len = 0;
+    endpoint_busy = false;
+    in_flight_timed = false;
+    irq_unlock(key);
+}
+
+static void in_ready_cb(const struct device *dev) {
+    if (in_flight_timed) {
+        in_flight_timed = false;
+        zmk_latency_report_delivered(in_flight_scan_time);
+    }
+
+    unsigned int key = irq_lock();
+    if (report_queue_len == 0) {
+        endpoint_busy = false;
+        irq_unlock(key);
+        return;
+    }
+
+    struct usb_hid_report report = *queued_report(0);
+    report_queue_head = (report_queue_head + 1) % CONFIG_ZMK_USB_HID_REPORT_QUEUE_SIZE;
+    report_queue_len--;
+    irq_unlock(key);
+
+    int err = write_report(report.data, report.len, report.timed, report.scan_time);
+    if (err) {
+        LOG_ERR("Failed to write queued report (err %d)", err);
+        reset_report_queue();
+    }
+}
+
+static void protocol_cb(const struct device *dev, uint8_t protocol) {
+    LOG_DBG("USB HID protocol changed to %s", protocol == HID_PROTOCOL_BOOT ? "boot" : "report");
+    // Queued reports were built for the previous protocol.
+    reset_report_queue();
+    hid_protocol = protocol;
+    zmk_hid_reports_invalidate();
+}
+
+#define USB_HID_REPORT_TYPE_OUTPUT 0x02
+
+static int set_report_cb(struct usb_setup_packet *setup, int32_t *len, uint8_t **data) {
+    if ((setup->wValue >> 8) != USB_HID_REPORT_TYPE_OUTPUT) {
+        LOG_WRN("Unsupported report type %d", setup->wValue >> 8);
+        return -ENOTSUP;
+    }
+
+    // Boot protocol output reports have no report ID.
+    if (hid_protocol == HID_PROTOCOL_BOOT) {
+        if (*len != sizeof(struct zmk_hid_led_report_body)) {
+            return -EINVAL;
+        }
+        struct zmk_hid_led_report_body *body = (struct zmk_hid_led_report_body *)*data;
+        zmk_hid_indicators_process_report(ZMK_ENDPOINT_USB, body->indicators);
+        return 0;
+    }
+
+#ifdef CONFIG_ZMK_RAW_HID
+    if (*len == sizeof(struct zmk_hid_raw_report) && (*data)[0] == ZMK_HID_REPORT_ID_RAW) {
+        struct zmk_hid_raw_report *report = (struct zmk_hid_raw_report *)*data;
+        return zmk_raw_hid_receive(ZMK_ENDPOINT_USB, NULL, report->body.data,
+                                   sizeof(report->body));
+    }
+#endif /* CONFIG_ZMK_RAW_HID */
+
+    struct zmk_hid_led_report *report = (struct zmk_hid_led_report *)*data;
+    if (*len != sizeof(*report) || report->report_id != zmk_hid_get_keyboard_report()->report_id) {
+        LOG_WRN("Unsupported output report");
+        return -EINVAL;
+    }
+
+    zmk_hid_indicators_process_report(ZMK_ENDPOINT_USB, report->body.indicators);
+    return 0;
+}
 
 static const struct hid_ops ops = {
+    .set_report = set_report_cb,
+    .protocol_change = protocol_cb,
     .int_in_ready = in_ready_cb,
 };
 
+bool zmk_usb_hid_is_boot_protocol() { return hid_protocol == HID_PROTOCOL_BOOT; }
+
 int zmk_usb_hid_send_report(const uint8_t *report, size_t len) {
+    if (len > USB_HID_MAX_REPORT_SIZE) {
+        return -EINVAL;
+    }
+
     switch (usb_status) {
     case USB_DC_SUSPEND:
         return usb_wakeup_request();
@@ -40,16 +360,27 @@ int zmk_usb_hid_send_report(const uint8_t *report, size_t len) {
     case USB_DC_DISCONNECTED:
     case USB_DC_UNKNOWN:
         return -ENODEV;
-    default:
-        k_sem_take(&hid_sem, K_MSEC(30));
-        int err = hid_int_ep_write(hid_dev, report, len, NULL);
+    default: {
+        uint32_t scan_time;
+        bool timed = is_key_report(report) && zmk_latency_claim_scan(&scan_time);
 
-        if (err) {
-            k_sem_give(&hid_sem);
+        unsigned int key = irq_lock();
+        if (endpoint_busy) {
+            int err = queue_report(report, len, timed, scan_time);
+            irq_unlock(key);
+            return err;
         }
+        endpoint_busy = true;
+        irq_unlock(key);
 
+        int err = write_report(report, len, timed, scan_time);
+        if (err) {
+            endpoint_busy = false;
+            in_flight_timed = false;
+        }
         return err;
     }
+    }
 }
 
 #endif /* CONFIG_ZMK_USB */
@@ -80,6 +411,22 @@ enum zmk_usb_conn_state zmk_usb_get_conn_state() {
 
 void usb_status_cb(enum usb_dc_status_code status, const uint8_t *params) {
     usb_status = status;
+#ifdef CONFIG_ZMK_USB
+    switch (status) {
+    case USB_DC_RESET:
+    case USB_DC_DISCONNECTED:
+        // Hosts start out in the report protocol and select the boot protocol after enumeration.
+        hid_protocol = HID_PROTOCOL_REPORT;
+        /* fall through */
+    case USB_DC_ERROR:
+    case USB_DC_CONFIGURED:
+        // Pending reports are stale for the new host state, and no IN transfer is in progress.
+        reset_report_queue();
+        break;
+    default:
+        break;
+    }
+#endif /* CONFIG_ZMK_USB */
     raise_usb_status_changed_event();
 };
 
@@ -95,6 +442,9 @@ static int zmk_usb_init(const struct device *_arg) {
 
     usb_hid_register_device(hid_dev, zmk_hid_report_desc, sizeof(zmk_hid_report_desc), &ops);
 
+    // Mark the interface as a boot keyboard, so a BIOS or KVM can select the boot protocol.
+    usb_hid_set_proto_code(hid_dev, HID_BOOT_IFACE_CODE_KEYBOARD);
+
     usb_hid_init(hid_dev);
 
 #endif /* CONFIG_ZMK_USB */
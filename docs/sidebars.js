@@ -13,11 +13,16 @@ module.exports = {
       "features/displays",
       "features/encoders",
       "features/underglow",
+      "features/raw-hid",
     ],
     Behaviors: [
       "behaviors/key-press",
       "behaviors/layers",
       "behaviors/misc",
+      "behaviors/auto-repeat",
+      "behaviors/caps-word",
+      "behaviors/leader-key",
+      "behaviors/mouse-emulation",
       "behaviors/hold-tap",
       "behaviors/mod-tap",
       "behaviors/reset",